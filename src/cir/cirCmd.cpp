@@ -14,6 +14,7 @@
 
 #include "cirGate.h"
 #include "cirMgr.h"
+#include "cirZip.h"
 #include "util.h"
 
 using namespace std;
@@ -29,9 +30,12 @@ bool initCirCmd()
           cmdMgr->regCmd("CIRSWeep", 5, new CirSweepCmd) &&
           cmdMgr->regCmd("CIROPTimize", 6, new CirOptCmd) &&
           cmdMgr->regCmd("CIRSTRash", 6, new CirStrashCmd) &&
+          cmdMgr->regCmd("CIRCompact", 4, new CirCompactCmd) &&
           cmdMgr->regCmd("CIRSIMulate", 6, new CirSimCmd) &&
           cmdMgr->regCmd("CIRFraig", 4, new CirFraigCmd) &&
-          cmdMgr->regCmd("CIRWrite", 4, new CirWriteCmd))) {
+          cmdMgr->regCmd("CIRWrite", 4, new CirWriteCmd) &&
+          cmdMgr->regCmd("CIRSAve", 5, new CirSaveCmd) &&
+          cmdMgr->regCmd("CIRLoad", 4, new CirLoadCmd))) {
         cerr << "Registering \"cir\" commands fails... exiting" << endl;
         return false;
     }
@@ -161,7 +165,7 @@ void CirPrintCmd::help() const
 }
 
 //----------------------------------------------------------------------
-//    CIRGate <<(int gateId)> [<-FANIn | -FANOut><(int level)>]>
+//    CIRGate <<(int gateId) | (string name)> [<-FANIn | -FANOut><(int level)>]>
 //----------------------------------------------------------------------
 CmdExecStatus CirGateCmd::exec(const string &option)
 {
@@ -180,7 +184,7 @@ CmdExecStatus CirGateCmd::exec(const string &option)
 
     int gateId = -1, level = 0;
     bool doFanin = false, doFanout = false;
-    CirGate *thisGate = 0;
+    CirGate thisGate;
     for (size_t i = 0, n = options.size(); i < n; ++i) {
         bool checkLevel = false;
 
@@ -197,7 +201,16 @@ CmdExecStatus CirGateCmd::exec(const string &option)
             doFanout = true;
             checkLevel = true;
         } else if (!thisGate) {
-            if (!myStr2Int(options[i], gateId) || gateId < 0) {
+            // Gate ID, or the symbolic name of a PI / PO
+            if (!myStr2Int(options[i], gateId)) {
+                thisGate = cirMgr->getGate(options[i]);
+                if (!thisGate) {
+                    cerr << "Error: Gate(" << options[i] << ") not found!!" << endl;
+                    return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+                }
+                continue;
+            }
+            if (gateId < 0) {
                 return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
             }
             thisGate = cirMgr->getGate(gateId);
@@ -228,18 +241,19 @@ CmdExecStatus CirGateCmd::exec(const string &option)
     }
 
     if (doFanin)
-        thisGate->reportFanin(level);
+        thisGate.reportFanin(level);
     else if (doFanout)
-        thisGate->reportFanout(level);
+        thisGate.reportFanout(level);
     else
-        thisGate->reportGate();
+        thisGate.reportGate();
 
     return CMD_EXEC_DONE;
 }
 
 void CirGateCmd::usage(ostream &os) const
 {
-    os << "Usage: CIRGate <<(int gateId)> [<-FANIn | -FANOut><(int level)>]>" << endl;
+    os << "Usage: CIRGate <<(int gateId) | (string name)> [<-FANIn | -FANOut><(int level)>]>"
+       << endl;
 }
 
 void CirGateCmd::help() const
@@ -363,9 +377,60 @@ void CirStrashCmd::help() const
          << "perform structural hash on the circuit netlist\n";
 }
 
+//----------------------------------------------------------------------
+//    CIRCompact [-Auto <on | off>]
+//----------------------------------------------------------------------
+CmdExecStatus CirCompactCmd::exec(const string &option)
+{
+    if (!cirMgr) {
+        cerr << "Error: circuit is not yet constructed!!" << endl;
+        return CMD_EXEC_ERROR;
+    }
+    // check option
+    vector<string> options;
+    CmdExec::lexOptions(option, options);
+
+    if (options.empty()) {
+        assert(curCmd != CIRINIT);
+        cirMgr->compact();
+        return CMD_EXEC_DONE;
+    }
+
+    if (myStrNCmp("-Auto", options[0], 2) != 0) {
+        return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[0]);
+    }
+    if (options.size() == 1) {
+        return CmdExec::errorOption(CMD_OPT_MISSING, options[0]);
+    }
+    if (options.size() > 2) {
+        return CmdExec::errorOption(CMD_OPT_EXTRA, options[2]);
+    }
+    if (myStrNCmp("ON", options[1], 2) == 0) {
+        cirMgr->setAutoCompact(true);
+    } else if (myStrNCmp("OFF", options[1], 3) == 0) {
+        cirMgr->setAutoCompact(false);
+    } else {
+        return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[1]);
+    }
+
+    return CMD_EXEC_DONE;
+}
+
+void CirCompactCmd::usage(ostream &os) const
+{
+    os << "Usage: CIRCompact [-Auto <on | off>]" << endl;
+}
+
+void CirCompactCmd::help() const
+{
+    cout << setw(15) << left << "CIRCompact: "
+         << "renumber the gates densely in topological order\n";
+}
+
 //----------------------------------------------------------------------
 //    CIRSIMulate <-Random | -File <string patternFile>>
-//                [-Output (string logFile)]
+//                [-Output (string logFile)][-Binary][-Words (int words)][-Native]
+//                [-Threads (int threads)][-Seed (int seed)]
 //----------------------------------------------------------------------
 CmdExecStatus CirSimCmd::exec(const string &option)
 {
@@ -379,7 +444,10 @@ CmdExecStatus CirSimCmd::exec(const string &option)
 
     ifstream patternFile;
     ofstream logFile;
-    bool doRandom = false, doFile = false, doLog = false;
+    string logName;
+    bool doRandom = false, doFile = false, doLog = false, doBinary = false, doWords = false;
+    bool doNative = false, doThreads = false, doSeed = false;
+    int words = CirMgr::SIM_WORDS, threads = 1, seed = 0;
     for (size_t i = 0, n = options.size(); i < n; ++i) {
         if (myStrNCmp("-Random", options[i], 2) == 0) {
             if (doRandom || doFile) {
@@ -393,7 +461,8 @@ CmdExecStatus CirSimCmd::exec(const string &option)
             if (++i == n) {
                 return CmdExec::errorOption(CMD_OPT_MISSING, options[i - 1]);
             }
-            patternFile.open(options[i].c_str(), ios::in);
+            // Text or binary patterns, told apart by the content
+            patternFile.open(options[i].c_str(), ios::in | ios::binary);
             if (!patternFile) {
                 return CmdExec::errorOption(CMD_OPT_FOPEN_FAIL, options[i]);
             }
@@ -405,11 +474,53 @@ CmdExecStatus CirSimCmd::exec(const string &option)
             if (++i == n) {
                 return CmdExec::errorOption(CMD_OPT_MISSING, options[i - 1]);
             }
-            logFile.open(options[i].c_str(), ios::out);
-            if (!logFile) {
-                return CmdExec::errorOption(CMD_OPT_FOPEN_FAIL, options[i]);
-            }
+            logName = options[i];
             doLog = true;
+        } else if (myStrNCmp("-Binary", options[i], 2) == 0) {
+            if (doBinary) {
+                return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+            }
+            doBinary = true;
+        } else if (myStrNCmp("-Words", options[i], 2) == 0) {
+            if (doWords) {
+                return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+            }
+            if (++i == n) {
+                return CmdExec::errorOption(CMD_OPT_MISSING, options[i - 1]);
+            }
+            if (!myStr2Int(options[i], words) || words < 1 ||
+                words > (int)CirMgr::SIM_WORDS_MAX) {
+                return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+            }
+            doWords = true;
+        } else if (myStrNCmp("-Native", options[i], 2) == 0) {
+            if (doNative) {
+                return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+            }
+            doNative = true;
+        } else if (myStrNCmp("-Threads", options[i], 2) == 0) {
+            if (doThreads) {
+                return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+            }
+            if (++i == n) {
+                return CmdExec::errorOption(CMD_OPT_MISSING, options[i - 1]);
+            }
+            if (!myStr2Int(options[i], threads) || threads < 1 ||
+                threads > (int)CirMgr::SIM_THREADS_MAX) {
+                return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+            }
+            doThreads = true;
+        } else if (myStrNCmp("-Seed", options[i], 2) == 0) {
+            if (doSeed) {
+                return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+            }
+            if (++i == n) {
+                return CmdExec::errorOption(CMD_OPT_MISSING, options[i - 1]);
+            }
+            if (!myStr2Int(options[i], seed) || seed < 0) {
+                return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+            }
+            doSeed = true;
         } else {
             return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
         }
@@ -418,14 +529,30 @@ CmdExecStatus CirSimCmd::exec(const string &option)
     if (!doRandom && !doFile) {
         return CmdExec::errorOption(CMD_OPT_MISSING, "");
     }
+    if (doBinary && !doLog) {
+        cerr << "Error: binary output needs a log file (-Output)!!" << endl;
+        return CMD_EXEC_ERROR;
+    }
+    if (doLog) {
+        logFile.open(logName.c_str(), (doBinary) ? ios::out | ios::binary : ios::out);
+        if (!logFile) {
+            return CmdExec::errorOption(CMD_OPT_FOPEN_FAIL, logName);
+        }
+    }
 
     assert(curCmd != CIRINIT);
     if (doLog) {
-        cirMgr->setSimLog(&logFile);
+        cirMgr->setSimLog(&logFile, doBinary);
     } else {
         cirMgr->setSimLog(0);
     }
 
+    cirMgr->setSimWords(words);
+    cirMgr->setSimNative(doNative);
+    cirMgr->setSimThreads(threads);
+    if (doSeed) {
+        cirMgr->setSimSeed(seed);
+    }
     if (doRandom) {
         cirMgr->randomSim();
     } else {
@@ -440,7 +567,8 @@ CmdExecStatus CirSimCmd::exec(const string &option)
 void CirSimCmd::usage(ostream &os) const
 {
     os << "Usage: CIRSIMulate <-Random | -File <string patternFile>>\n"
-       << "                   [-Output (string logFile)]" << endl;
+       << "                   [-Output (string logFile)][-Binary][-Words (int words)][-Native]\n"
+       << "                   [-Threads (int threads)][-Seed (int seed)]" << endl;
 }
 
 void CirSimCmd::help() const
@@ -488,7 +616,7 @@ void CirFraigCmd::help() const
 }
 
 //----------------------------------------------------------------------
-//    CIRWrite [(int gateId)][-Output (string aagFile)]
+//    CIRWrite [(int gateId)][-Output (string aagFile)][-Binary]
 //----------------------------------------------------------------------
 CmdExecStatus CirWriteCmd::exec(const string &option)
 {
@@ -504,9 +632,10 @@ CmdExecStatus CirWriteCmd::exec(const string &option)
         cirMgr->writeAag(cout);
         return CMD_EXEC_DONE;
     }
-    bool hasFile = false;
+    bool hasFile = false, doBinary = false;
     int gateId;
-    CirGate *thisGate = NULL;
+    string fileName;
+    CirGate thisGate;
     ofstream outfile;
     for (size_t i = 0, n = options.size(); i < n; ++i) {
         if (myStrNCmp("-Output", options[i], 2) == 0) {
@@ -516,13 +645,15 @@ CmdExecStatus CirWriteCmd::exec(const string &option)
             if (++i == n) {
                 return CmdExec::errorOption(CMD_OPT_MISSING, options[i - 1]);
             }
-            outfile.open(options[i].c_str(), ios::out);
-            if (!outfile) {
-                return CmdExec::errorOption(CMD_OPT_FOPEN_FAIL, options[1]);
-            }
+            fileName = options[i];
             hasFile = true;
+        } else if (myStrNCmp("-Binary", options[i], 2) == 0) {
+            if (doBinary) {
+                return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+            }
+            doBinary = true;
         } else if (myStr2Int(options[i], gateId) && gateId >= 0) {
-            if (thisGate != NULL) {
+            if (thisGate) {
                 return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
             }
             thisGate = cirMgr->getGate(gateId);
@@ -530,7 +661,7 @@ CmdExecStatus CirWriteCmd::exec(const string &option)
                 cerr << "Error: Gate(" << gateId << ") not found!!" << endl;
                 return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
             }
-            if (!thisGate->isAig()) {
+            if (!thisGate.isAig()) {
                 cerr << "Error: Gate(" << gateId << ") is NOT an AIG!!" << endl;
                 return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
             }
@@ -539,13 +670,37 @@ CmdExecStatus CirWriteCmd::exec(const string &option)
         }
     }
 
+    if (thisGate && doBinary) {
+        cerr << "Error: binary output of a single gate is not supported!!" << endl;
+        return CMD_EXEC_ERROR;
+    }
+
+    // "*.gz" and "*.xz" files are compressed on the fly
+    CirZipType zipType = (hasFile) ? cirZipType(fileName) : CIR_ZIP_NONE;
+    if (hasFile) {
+        outfile.open(fileName.c_str(),
+                     (doBinary || zipType != CIR_ZIP_NONE) ? ios::out | ios::binary : ios::out);
+        if (!outfile) {
+            return CmdExec::errorOption(CMD_OPT_FOPEN_FAIL, fileName);
+        }
+    }
+    CirZipBuf zipBuf((hasFile) ? outfile.rdbuf() : cout.rdbuf(), zipType);
+    ostream zipOut(&zipBuf);
+    ostream &os = (zipType != CIR_ZIP_NONE) ? zipOut : (hasFile) ? outfile : cout;
+
     if (!thisGate) {
-        assert(hasFile);
-        cirMgr->writeAag(outfile);
-    } else if (hasFile) {
-        cirMgr->writeGate(outfile, thisGate);
+        if (doBinary) {
+            cirMgr->writeAig(os);
+        } else {
+            cirMgr->writeAag(os);
+        }
     } else {
-        cirMgr->writeGate(cout, thisGate);
+        cirMgr->writeGate(os, gateId);
+    }
+
+    if (!zipBuf.finish() || !outfile) {
+        cerr << "Error: cannot write to \"" << fileName << "\"!!" << endl;
+        return CMD_EXEC_ERROR;
     }
 
     return CMD_EXEC_DONE;
@@ -553,11 +708,122 @@ CmdExecStatus CirWriteCmd::exec(const string &option)
 
 void CirWriteCmd::usage(ostream &os) const
 {
-    os << "Usage: CIRWrite [(int gateId)][-Output (string aagFile)]" << endl;
+    os << "Usage: CIRWrite [(int gateId)][-Output (string aagFile)][-Binary]" << endl;
 }
 
 void CirWriteCmd::help() const
 {
     cout << setw(15) << left << "CIRWrite: "
-         << "write the netlist to an ASCII AIG file (.aag)\n";
+         << "write the netlist to an ASCII (.aag) or binary (.aig) AIG file\n";
+}
+
+//----------------------------------------------------------------------
+//    CIRSAve <(string fileName)>
+//----------------------------------------------------------------------
+CmdExecStatus CirSaveCmd::exec(const string &option)
+{
+    if (!cirMgr) {
+        cerr << "Error: circuit is not yet constructed!!" << endl;
+        return CMD_EXEC_ERROR;
+    }
+    // check option
+    string fileName;
+    if (!CmdExec::lexSingleOption(option, fileName, false)) {
+        return CMD_EXEC_ERROR;
+    }
+
+    ofstream outfile(fileName.c_str(), ios::out | ios::binary);
+    if (!outfile) {
+        return CmdExec::errorOption(CMD_OPT_FOPEN_FAIL, fileName);
+    }
+    CirZipBuf zipBuf(outfile.rdbuf(), cirZipType(fileName));
+    ostream os(&zipBuf);
+
+    cirMgr->saveCircuit(os, curCmd);
+
+    if (!zipBuf.finish() || !outfile) {
+        cerr << "Error: cannot write to \"" << fileName << "\"!!" << endl;
+        return CMD_EXEC_ERROR;
+    }
+
+    return CMD_EXEC_DONE;
+}
+
+void CirSaveCmd::usage(ostream &os) const
+{
+    os << "Usage: CIRSAve <(string fileName)>" << endl;
+}
+
+void CirSaveCmd::help() const
+{
+    cout << setw(15) << left << "CIRSAve: "
+         << "save the circuit, FEC groups and signatures to a checkpoint" << endl;
+}
+
+//----------------------------------------------------------------------
+//    CIRLoad <(string fileName)> [-Replace]
+//----------------------------------------------------------------------
+CmdExecStatus CirLoadCmd::exec(const string &option)
+{
+    // check option
+    vector<string> options;
+    if (!CmdExec::lexOptions(option, options)) return CMD_EXEC_ERROR;
+    if (options.empty()) return CmdExec::errorOption(CMD_OPT_MISSING, "");
+
+    bool doReplace = false;
+    string fileName;
+    for (size_t i = 0, n = options.size(); i < n; ++i) {
+        if (myStrNCmp("-Replace", options[i], 2) == 0) {
+            if (doReplace) {
+                return CmdExec::errorOption(CMD_OPT_EXTRA, options[i]);
+            }
+            doReplace = true;
+        } else {
+            if (fileName.size()) {
+                return CmdExec::errorOption(CMD_OPT_ILLEGAL, options[i]);
+            }
+            fileName = options[i];
+        }
+    }
+
+    if (cirMgr != 0) {
+        if (doReplace) {
+            cerr << "Note: original circuit is replaced..." << endl;
+            curCmd = CIRINIT;
+            delete cirMgr;
+            cirMgr = 0;
+        } else {
+            cerr << "Error: circuit already exists!!" << endl;
+            return CMD_EXEC_ERROR;
+        }
+    }
+    cirMgr = new CirMgr;
+
+    unsigned int state = CIRINIT;
+    bool ok = cirMgr->loadCircuit(fileName, state);
+    if (ok && (state == CIRINIT || state >= CIRCMDTOT)) {
+        cerr << "Error: checkpoint \"" << fileName << "\" is corrupted!!" << endl;
+        ok = false;
+    }
+    if (!ok) {
+        curCmd = CIRINIT;
+        delete cirMgr;
+        cirMgr = 0;
+        return CMD_EXEC_ERROR;
+    }
+
+    curCmd = (CirCmdState)state;
+
+    return CMD_EXEC_DONE;
+}
+
+void CirLoadCmd::usage(ostream &os) const
+{
+    os << "Usage: CIRLoad <(string fileName)> [-Replace]" << endl;
+}
+
+void CirLoadCmd::help() const
+{
+    cout << setw(15) << left << "CIRLoad: "
+         << "restore the circuit from a checkpoint" << endl;
 }
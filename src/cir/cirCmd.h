@@ -17,8 +17,11 @@ CmdClass(CirGateCmd);
 CmdClass(CirSweepCmd);
 CmdClass(CirOptCmd);
 CmdClass(CirStrashCmd);
+CmdClass(CirCompactCmd);
 CmdClass(CirSimCmd);
 CmdClass(CirFraigCmd);
 CmdClass(CirWriteCmd);
+CmdClass(CirSaveCmd);
+CmdClass(CirLoadCmd);
 
 #endif  // CIR_CMD_H
@@ -11,6 +11,15 @@
 
 // TODO: define your own typedef or enum
 
+enum GateType {
+    UNDEF_GATE = 0,
+    PI_GATE = 1,
+    PO_GATE = 2,
+    AIG_GATE = 3,
+    CONST_GATE = 4,
+    NO_GATE = 5  // Empty slot of the gate table
+};
+
 class CirGate;
 class CirMgr;
 class SatSolver;
@@ -19,7 +19,7 @@
 using namespace std;
 
 using Hash = CirGateHash;
-using HashNode = std::pair<size_t, CirGate *>;
+using HashNode = std::pair<size_t, unsigned int>;
 
 /*******************************/
 /*   Global variable and enum  */
@@ -38,23 +38,17 @@ using HashNode = std::pair<size_t, CirGate *>;
 void CirMgr::strash()
 {
     // TODO
-    unordered_map<size_t, CirGate *> table;
-    unordered_map<size_t, CirGate *>::iterator it;
-    vector<CirGate *> dfslist;
+    unordered_map<size_t, unsigned int> table;
+    unordered_map<size_t, unsigned int>::iterator it;
+    vector<unsigned int> dfslist = dfsList();  // Merging drops the cached list
 
-    // Make DFSList
-    CirGate::raiseGlobalMarker();
-    for (size_t i = _M + 1; i < _M + _O + 1; ++i) {
-        DepthFirstTraversal(_gates[i], dfslist);
-    }
-
-    // STRASH for each CirAIGate
+    // STRASH for each AIG gate
     for (size_t i = 0; i < dfslist.size(); ++i) {
-        if (!dfslist[i]->isAig()) {
+        if (_store.type[dfslist[i]] != AIG_GATE) {
             continue;
         }
 
-        Hash key(dfslist[i]);
+        Hash key(_store, dfslist[i]);
 
         it = table.find(key());
 
@@ -63,23 +57,27 @@ void CirMgr::strash()
         if (it == table.end()) {  
             table.insert(HashNode(key(), dfslist[i]));
         } else if (identityStruct(dfslist[i], it->second)) {
-            StrashMsg(dfslist[i], it->second);
-            mergeGate(dfslist[i], it->second);
+            StrashMsg(dfslist[i], 2 * it->second);
+            mergeGate(dfslist[i], 2 * it->second);
         } else {
             table.insert(HashNode(key(), dfslist[i]));
         }
     }
 
     // Maintain CirMgr Property
+    compactLists();
     _notused.clear();
     getNotUsedList(_notused);
     _floating.clear();
     getFloatingList(_floating);
+    autoCompact();
 }
 
 void CirMgr::fraig()
 {
-    vector<CirGate *> unSATGroup, SATGroup;
+    vector<unsigned int> unSATGroup, SATGroup;
+    vector<unsigned int> order(_M + 1, 0);
+    vector<unsigned int> dfslist;
     SatSolver solver;
     Var tmpVar;
     bool isSat;
@@ -91,15 +89,36 @@ void CirMgr::fraig()
     solver.initialize();
 
     for (int i = 0; i < _M + 1; ++i) {
-        if (_gates[i]) _gates[i]->setVar(solver.newVar());
+        if (_store.has(i)) _store.var[i] = solver.newVar();
     }
 
     createCNF(solver);
 
-    sort(FECs.begin(), FECs.end(), [](const vector<CirGate *> &a, const vector<CirGate *> &b) {
+    sort(FECs.begin(), FECs.end(), [](const vector<unsigned int> &a, const vector<unsigned int> &b) {
         return a.size() < b.size();
     });
 
+    // Gates are merged into the first one of the group, which must not be in
+    // their fanout cone: order each group by a topological order of all AIGs,
+    // after CONST and PIs
+    dfslist = dfsList();
+    CirGate::raiseGlobalMarker();
+    for (size_t i = 0; i < dfslist.size(); ++i) {
+        _store.marker[dfslist[i]] = CirGate::_globalMarker;
+    }
+    for (size_t a = 0; a < _aig.size(); ++a) {
+        DepthFirstTraversal(_aig[a], dfslist);
+    }
+    for (size_t i = 0; i < dfslist.size(); ++i) {
+        if (_store.type[dfslist[i]] == AIG_GATE) {
+            order[dfslist[i]] = i + 1;
+        }
+    }
+    for (size_t i = 0; i < FECs.size(); ++i) {
+        stable_sort(FECs[i].begin(), FECs[i].end(),
+                    [&](unsigned int a, unsigned int b) { return order[a / 2] < order[b / 2]; });
+    }
+
     for (size_t i = 0; i < FECs.size(); ++i) {
         // Looping elements For each group
         for (size_t j = 0; j < FECs[i].size(); ++j) {
@@ -112,56 +131,57 @@ void CirMgr::fraig()
             for (size_t k = j + 1; k < FECs[i].size(); ++k) {
                 // Try to prove SAT(f, g)
                 tmpVar = solver.newVar();
-                solver.addXorCNF(tmpVar, gate(FECs[i][j])->_var, isInv(FECs[i][j]),
-                                 gate(FECs[i][k])->_var, isInv(FECs[i][k]));
+                solver.addXorCNF(tmpVar, _store.var[FECs[i][j] / 2], isInv(FECs[i][j]),
+                                 _store.var[FECs[i][k] / 2], isInv(FECs[i][k]));
                 solver.assumeRelease();
                 solver.assumeProperty(tmpVar, true);
 
                 isSat = solver.assumpSolve();
 
                 // getSatAssignment()
-                cout << "\rProving " << gate(FECs[i][j])->_gateId << " = "
-                     << gate(FECs[i][k])->_gateId << "..." << ((isSat) ? "SAT" : "UNSAT\n");
+                cout << "\rProving " << FECs[i][j] / 2 << " = " << FECs[i][k] / 2 << "..."
+                     << ((isSat) ? "SAT" : "UNSAT\n");
 
                 // Mark if unSAT
                 if (!isSat) {
-                    unSATGroup.push_back(FECs[i][j]);
+                    unSATGroup.push_back(FECs[i][k]);
                 }
             }
 
-            // If unSAT occurs
-            if (unSATGroup.size() > 2) {
+            // If unSAT occurs, merge into the first gate. The literals are in
+            // phase with the group: gate k equals unSATGroup[0] ^ isInv(unSATGroup[k])
+            if (unSATGroup.size() > 1) {
                 for (size_t k = 1; k < unSATGroup.size(); ++k) {
-                    FraigMsg(unSATGroup[k], unSATGroup[0]);
-                    mergeGate(unSATGroup[k], unSATGroup[0]);
+                    FraigMsg(unSATGroup[k] / 2, unSATGroup[0] ^ isInv(unSATGroup[k]));
+                    mergeGate(unSATGroup[k] / 2, unSATGroup[0] ^ isInv(unSATGroup[k]));
                     FECs[i].erase(find(FECs[i].begin(), FECs[i].end(), unSATGroup[k]));
                 }
-
-                FECs[i].erase(find(FECs[i].begin(), FECs[i].end(), unSATGroup[0]));
             }
         }
     }
 
     FECs.clear();
+    compactLists();
+    autoCompact();
 }
 
 /********************************************/
 /*   Private member functions about strash  */
 /********************************************/
 
-bool CirMgr::identityStruct(CirGate *a, CirGate *b) const
+bool CirMgr::identityStruct(unsigned int a, unsigned int b) const
 {
     // TODO
     return true;
 
-    size_t size = a->_fanin.size();
+    size_t size = _store.faninSize(a);
 
-    if ((a->_fanin.size() != 2) || (b->_fanin.size() != 2)) {
+    if ((_store.faninSize(a) != 2) || (_store.faninSize(b) != 2)) {
         return false;
     }
 
     for (size_t i = 0; i < size; ++i) {
-        if (a->_fanin[i] != b->_fanin[i]) {
+        if (_store.fanin[2 * a + i] != _store.fanin[2 * b + i]) {
             return false;
         }
     }
@@ -169,40 +189,30 @@ bool CirMgr::identityStruct(CirGate *a, CirGate *b) const
     return true;
 }
 
-void CirMgr::StrashMsg(CirGate *from, CirGate *to) const
+void CirMgr::StrashMsg(unsigned int from, const unsigned int &to) const
 {
-    cout << "Strashing: " << gate(to)->_gateId << " merging " << ((isInv(to)) ? "!" : "")
-         << from->_gateId << "..." << endl;
+    cout << "Strashing: " << to / 2 << " merging " << ((isInv(to)) ? "!" : "") << from << "..."
+         << endl;
 }
 
 /********************************************/
 /*   Private member functions about fraig   */
 /********************************************/
 
-void CirGate::setVar(const Var &var)
-{
-    _var = var;
-}
-
-Var CirGate::getVar()
-{
-    return _var;
-}
-
 void CirMgr::createCNF(SatSolver &solver)
 {
-    CirGate *target;
+    unsigned int *in;
     size_t size = _aig.size();
 
     for (int i = 0; i < size; ++i) {
-        target = _gates[_aig[i]];
-        solver.addAigCNF(target->_var, gate(target->_fanin[0])->_var, isInv(target->_fanin[0]),
-                         gate(target->_fanin[1])->_var, isInv(target->_fanin[1]));
+        in = &_store.fanin[2 * _aig[i]];
+        solver.addAigCNF(_store.var[_aig[i]], _store.var[in[0] / 2], isInv(in[0]),
+                         _store.var[in[1] / 2], isInv(in[1]));
     }
 }
 
-void CirMgr::FraigMsg(CirGate *from, CirGate *to) const
+void CirMgr::FraigMsg(unsigned int from, const unsigned int &to) const
 {
-    cout << "Fraig: " << gate(to)->_gateId << " merging " << ((isInv(to)) ? "!" : "")
-         << from->_gateId << "..." << endl;
+    cout << "Fraig: " << to / 2 << " merging " << ((isInv(to)) ? "!" : "") << from << "..."
+         << endl;
 }
\ No newline at end of file
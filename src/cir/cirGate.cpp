@@ -10,7 +10,9 @@
 
 #include <stdarg.h>
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
@@ -41,55 +43,264 @@ bool isInv(size_t c)
     return c & size_t(NEG);
 }
 
-bool isInv(CirGate *c)
+/*******************************************/
+/*   class CirSymbolTable member functions */
+/*******************************************/
+
+unsigned int CirSymbolTable::find(const string &s) const
 {
-    return (size_t)c & size_t(NEG);
+    return _index.empty() ? NO_LIT : _index[probe(s.c_str(), s.size())];
 }
 
-unsigned int getNum(CirGate *c)
+/*
+   Reuse the pooled chars when the name is already known, otherwise append
+   it to the pool and index it under this gate.
+*/
+void CirSymbolTable::insert(unsigned int id, const string &s)
 {
-    return (unsigned int)(size_t)c;
+    size_t i;
+
+    assert(!has(id));
+
+    if (id >= _offset.size()) {
+        _offset.resize(id + 1, NO_LIT);
+    }
+    if (2 * (_size + 1) > _index.size()) {
+        grow();
+    }
+
+    i = probe(s.c_str(), s.size());
+    if (_index[i] != NO_LIT) {
+        _offset[id] = _offset[_index[i]];
+        return;
+    }
+
+    _offset[id] = _pool.size();
+    _pool.append(s.c_str(), s.size() + 1);
+    _index[i] = id;
+    ++_size;
 }
 
-CirGate *setNum(size_t n)
+void CirSymbolTable::clear()
 {
-    return (CirGate *)n;
+    string().swap(_pool);
+    vector<unsigned int>().swap(_offset);
+    vector<unsigned int>().swap(_index);
+    _size = 0;
 }
 
-CirGate *setNum(unsigned int n)
+/*
+   FNV-1a hash of the name.
+*/
+size_t CirSymbolTable::hashName(const char *s, size_t n)
 {
-    return (CirGate *)(size_t)n;
+    size_t h = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < n; ++i) {
+        h = (h ^ (unsigned char)s[i]) * 1099511628211ULL;
+    }
+
+    return h;
 }
 
-CirGate *setInv(size_t c)
+/*
+   Linear probing on the index, of which the size is a power of 2.
+
+   @return
+      Slot of the gate named s, or the empty slot where it would go
+*/
+size_t CirSymbolTable::probe(const char *s, size_t n) const
 {
-    return (CirGate *)(c | size_t(NEG));
+    size_t mask = _index.size() - 1;
+    size_t i = hashName(s, n) & mask;
+    const char *name;
+
+    for (; _index[i] != NO_LIT; i = (i + 1) & mask) {
+        name = get(_index[i]);
+        if (!strncmp(name, s, n) && !name[n]) {
+            break;
+        }
+    }
+
+    return i;
 }
 
-CirGate *setInv(CirGate *c)
+void CirSymbolTable::grow()
 {
-    return (CirGate *)((size_t)c | size_t(NEG));
+    vector<unsigned int> old;
+    const char *name;
+
+    old.swap(_index);
+    _index.assign(std::max<size_t>(16, 2 * old.size()), NO_LIT);
+    for (size_t i = 0; i < old.size(); ++i) {
+        if (old[i] != NO_LIT) {
+            name = get(old[i]);
+            _index[probe(name, strlen(name))] = old[i];
+        }
+    }
 }
 
-CirGate *gate(size_t c)
+/**************************************/
+/*   class CirStore member functions  */
+/**************************************/
+
+void CirStore::assign(size_t n)
 {
-    return (CirGate *)(c & ~size_t(NEG));
+    type.assign(n, NO_GATE);
+    lineNo.assign(n, 0);
+    fanin.assign(2 * n, NO_LIT);
+    invalidateFanout();
+    symbol.clear();
+    origId.clear();
+    state.assign(n, 0);
+    marker.assign(n, 0);
+    var.assign(n, 0);
 }
 
-CirGate *gate(CirGate *c)
+void CirStore::erase(size_t id)
 {
-    return (CirGate *)((size_t)c & ~size_t(NEG));
+    type[id] = NO_GATE;
+    lineNo[id] = 0;
+    fanin[2 * id] = fanin[2 * id + 1] = NO_LIT;
+}
+
+void CirStore::clear()
+{
+    vector<unsigned char>().swap(type);
+    vector<unsigned int>().swap(lineNo);
+    vector<unsigned int>().swap(fanin);
+    invalidateFanout();
+    symbol.clear();
+    vector<unsigned int>().swap(origId);
+    vector<size_t>().swap(state);
+    vector<unsigned int>().swap(marker);
+    vector<Var>().swap(var);
+}
+
+void CirStore::addFanin(size_t id, unsigned int lit)
+{
+    assert(faninSize(id) < 2);
+
+    fanin[2 * id + faninSize(id)] = lit;
+}
+
+/*
+   The index holds the fanouts at build time. A rewired fanin is recorded in
+   fanoutMoved, and the fanouts which have been removed since are skipped.
+   The index is kept across the passes, so the fanouts moved by a merge stay
+   after the gate's own ones, in merge order.
+*/
+/*
+   The index holds the fanouts at build time. A rewired fanin slot is
+   recorded in fanoutMoved, and the slots which no longer have the gate as
+   fanin are skipped.
+*/
+void CirStore::getFanoutSlot(size_t id, vector<unsigned int> &out) const
+{
+    unordered_map<unsigned int, vector<unsigned int> >::const_iterator it;
+
+    if (fanoutBeg.empty()) {
+        buildFanout();
+    }
+
+    out.clear();
+    for (size_t i = fanoutBeg[id]; i < fanoutBeg[id + 1]; ++i) {
+        if (isFanout(id, fanoutSlot[i])) {
+            out.push_back(fanoutSlot[i]);
+        }
+    }
+
+    if ((it = fanoutMoved.find(id)) != fanoutMoved.end()) {
+        for (size_t i = 0; i < it->second.size(); ++i) {
+            if (isFanout(id, it->second[i])) {
+                out.push_back(it->second[i]);
+            }
+        }
+    }
+}
+
+/*
+   @param out
+      Literal of each fanout gate, in the phase of its fanin
+*/
+void CirStore::getFanout(size_t id, vector<unsigned int> &out) const
+{
+    getFanoutSlot(id, out);
+    for (size_t i = 0; i < out.size(); ++i) {
+        out[i] = 2 * (out[i] / 2) + isInv(fanin[out[i]]);
+    }
+}
+
+void CirStore::addFanout(size_t id, unsigned int slot)
+{
+    // Without an index the fanout is picked up by the next build
+    if (!fanoutBeg.empty()) {
+        fanoutMoved[id].push_back(slot);
+    }
+}
+
+void CirStore::invalidateFanout()
+{
+    vector<unsigned int>().swap(fanoutBeg);
+    vector<unsigned int>().swap(fanoutSlot);
+    fanoutMoved.clear();
+}
+
+/*
+   Counting sort of the fanin slots by their fanin gate. The slots are
+   visited in order, so each list comes out sorted by fanout gate ID.
+*/
+void CirStore::buildFanout() const
+{
+    size_t n = type.size();
+    vector<unsigned int> pos;
+
+    fanoutBeg.assign(n + 1, 0);
+    for (size_t i = 0; i < 2 * n; ++i) {
+        if (fanin[i] != NO_LIT) {
+            ++fanoutBeg[fanin[i] / 2 + 1];
+        }
+    }
+    for (size_t i = 0; i < n; ++i) {
+        fanoutBeg[i + 1] += fanoutBeg[i];
+    }
+
+    pos.assign(fanoutBeg.begin(), fanoutBeg.end() - 1);
+    fanoutSlot.resize(fanoutBeg[n]);
+    for (size_t i = 0; i < 2 * n; ++i) {
+        if (fanin[i] != NO_LIT) {
+            fanoutSlot[pos[fanin[i] / 2]++] = i;
+        }
+    }
 }
 
 /**************************************/
 /*   class CirGate member functions   */
 /**************************************/
 
+string CirGate::getTypeStr() const
+{
+    switch (getType()) {
+        case UNDEF_GATE:
+            return "UNDEF";
+        case PI_GATE:
+            return "PI";
+        case PO_GATE:
+            return "PO";
+        case AIG_GATE:
+            return "AIG";
+        case CONST_GATE:
+            return "CONST";
+        default:
+            return "";
+    }
+}
+
 void CirGate::reportGate() const
 {
-    vector<vector<CirGate *> > FECGroups;
-    vector<vector<CirGate *> >::iterator it;
-    vector<CirGate *>::iterator cit;
+    vector<vector<unsigned int> > FECGroups;
+    vector<vector<unsigned int> >::iterator it;
+    vector<unsigned int>::iterator cit;
     stringstream ss;
 
     // Store informations in stringstream
@@ -98,10 +309,14 @@ void CirGate::reportGate() const
 
     // LINE-1: Type and Defined LineNo
     ss << "= " << getTypeStr() << '(' << _gateId << ")";
-    if (_symbol != "") {
-        ss << '"' << _symbol << '"';
+    if (hasSymbol()) {
+        ss << '"' << getSymbol() << '"';
+    }
+    ss << ", line " << getLineNo();
+    if (getOrigId() != _gateId) {
+        ss << ", was " << getOrigId();
     }
-    ss << ", line " << _lineno << endl;
+    ss << endl;
 
     // LINE-2: FEC-Groups
     ss << "= FECs:";
@@ -111,20 +326,20 @@ void CirGate::reportGate() const
 
     for (it = FECGroups.begin(); it != FECGroups.end(); ++it) {
         // Positive
-        cit = find(it->begin(), it->end(), this);
+        cit = find(it->begin(), it->end(), 2 * _gateId);
         if (cit != it->end()) {
             for (cit = it->begin(); cit != it->end(); ++cit) {
-                ss << ' ' << ((isInv(*cit)) ? "!" : "") << gate(*cit)->_gateId;
+                ss << ' ' << ((isInv(*cit)) ? "!" : "") << *cit / 2;
             }
 
             break;
         }
 
         // Negative
-        cit = find(it->begin(), it->end(), setInv((CirGate *)this));
+        cit = find(it->begin(), it->end(), 2 * _gateId + 1);
         if (cit != it->end()) {
             for (cit = it->begin(); cit != it->end(); ++cit) {
-                ss << ' ' << ((isInv(*cit)) ? "" : "!") << gate(*cit)->_gateId;
+                ss << ' ' << ((isInv(*cit)) ? "" : "!") << *cit / 2;
             }
 
             break;
@@ -136,7 +351,7 @@ void CirGate::reportGate() const
     // LINE-3: Value
     ss << "= Value: ";
     for (int i = 63; i >= 0; --i) {
-        ss << (bool)(((size_t)1 << i) & _state) << ((i % 8 == 0 && i) ? "_" : "");
+        ss << (bool)(((size_t)1 << i) & getState()) << ((i % 8 == 0 && i) ? "_" : "");
     }
     ss << endl;
 
@@ -157,166 +372,66 @@ void CirGate::reportFanin(int level)
 {
     assert(level >= 0);
     raiseGlobalMarker();
-    reportFanin(level, 0, false);
+    _store->traverse(
+        2 * _gateId, false,
+        [&](unsigned int lit, unsigned int depth) {
+            return CirGate(_store, lit / 2).reportLine(level - depth, depth, isInv(lit), false);
+        },
+        [](unsigned int, unsigned int) {});
 }
 
 void CirGate::reportFanout(int level)
 {
     assert(level >= 0);
     raiseGlobalMarker();
-    reportFanout(level, 0, false);
+    _store->traverse(
+        2 * _gateId, true,
+        [&](unsigned int lit, unsigned int depth) {
+            return CirGate(_store, lit / 2).reportLine(level - depth, depth, isInv(lit), true);
+        },
+        [](unsigned int, unsigned int) {});
 }
 
-void CirGate::reportFanin(int level, int indent, bool invert)
+/*
+   @param level
+      Levels left to report below the gate
+   @param depth
+      Levels above the gate, for the indent
+*/
+bool CirGate::reportLine(int level, unsigned int depth, bool invert, bool toFanout)
 {
     // Cout state of (this) CirGate, with specified indent
-    cout << string(indent, ' ');
+    cout << string(INDENT * depth, ' ');
     if (invert) {
         cout << '!';
     }
     cout << getTypeStr() << ' ' << _gateId;
 
-    // Cout (*) if the fanin was hidden
-    if (isMarked() && _fanin.size() && level) {
+    // Cout (*) if the fanin / fanout was hidden
+    if (isMarked() && level && (toFanout ? fanout().size() : faninSize())) {
         cout << " (*)";
     }
 
     // End Message;
     cout << endl;
 
-    // For each gate in _fanin should call this function recursively
+    // The fanins / fanouts are reported only once
     if (level > 0 && !isMarked()) {
         mark();
-
-        indent += INDENT;
-        for (vector<CirGate *>::iterator it = _fanin.begin(); it != _fanin.end(); ++it) {
-            gate(*it)->reportFanin(level - 1, indent, (isInv(*it)) ? true : false);
-        }
+        return true;
     }
-}
-
-void CirGate::reportFanout(int level, int indent, bool invert)
-{
-    // Cout state of (this) CirGate, with specified indent
-    cout << string(indent, ' ');
-    if (invert) {
-        cout << '!';
-    };
-    cout << getTypeStr() << ' ' << _gateId;
 
-    // Cout (*) if the fanout was hidden
-    if (isMarked() && _fanout.size() && level) {
-        cout << " (*)";
-    }
-
-    // End Message;
-    cout << endl;
-
-    // For each gate in _fanout should call this function recursively
-    if (level > 0 && !isMarked()) {
-        mark();
-
-        indent += INDENT;
-        for (vector<CirGate *>::iterator it = _fanout.begin(); it != _fanout.end(); ++it) {
-            gate(*it)->reportFanout(level - 1, indent, (isInv(*it)) ? true : false);
-        }
-    }
+    return false;
 }
 
-void CirGate::disconnectFanin(CirGate *inGate)
-{
-    CirGate *gptr;
-    int count;
-
-    if (!inGate) {
-        for (size_t i = 0; i < _fanin.size(); ++i) {
-            gptr = gate(_fanin[i]);
-            count = ::count(gptr->_fanout.begin(), gptr->_fanout.end(),
-                            (isInv(_fanin[i])) ? setInv(this) : this);
-            gptr->_fanout.erase(find(gptr->_fanout.begin(), gptr->_fanout.end(),
-                                     (isInv(_fanin[i])) ? setInv(this) : this));
-        }
-    } else {
-        gptr = gate(inGate);
-        gptr->_fanout.erase(find(gptr->_fanout.begin(), gptr->_fanout.end(),
-                                 (isInv(inGate)) ? setInv(this) : this));
-    }
-}
-
-void CirGate::disconnectFanout(CirGate *outGate)
-{
-    CirGate *gptr;
-
-    if (!outGate) {
-        for (size_t i = 0; i < _fanout.size(); ++i) {
-            gptr = gate(_fanout[i]);
-            gptr->_fanin.erase(find(gptr->_fanin.begin(), gptr->_fanin.end(),
-                                    (isInv(_fanout[i])) ? setInv(this) : this));
-        }
-    } else {
-        gptr = gate(outGate);
-        gptr->_fanin.erase(
-            find(gptr->_fanin.begin(), gptr->_fanin.end(), (isInv(outGate)) ? setInv(this) : this));
-    }
-}
-
-void CirGate::disconnect()
-{
-    disconnectFanin(NULL);
-    disconnectFanout(NULL);
-}
-
-void CirGate::addFanin(CirGate *c, bool isInv)
-{
-    if (isInv) {
-        c = setInv(c);
-    }
-    _fanin.push_back(c);
-}
-
-void CirGate::addFanout(CirGate *c, bool isInv)
-{
-    if (isInv) {
-        c = setInv(c);
-    }
-    _fanout.push_back(c);
-}
-
-/***************************************/
-/* class CirConstGate member functions */
-/***************************************/
-
-void CirConstGate::printGate() const {}
-
-/***************************************/
-/* class CirUndefGate member functions */
-/***************************************/
-
-void CirUndefGate::printGate() const {}
-
-/***************************************/
-/* class CirPIGate member functions    */
-/***************************************/
-
-void CirPIGate::printGate() const {}
-
-/***************************************/
-/* class CirPOGate member functions    */
-/***************************************/
-
-void CirPOGate::printGate() const {}
-
-/***************************************/
-/* class CirAIGate member functions    */
-/***************************************/
-
-void CirAIGate::printGate() const {}
-
 //------------------------------------------------------------------------
 //   class CirGateHash
 //------------------------------------------------------------------------
 
-CirGateHash::CirGateHash(CirGate *c) : _in0((size_t)c->_fanin[0]), _in1((size_t)c->_fanin[1]) {}
+CirGateHash::CirGateHash(const CirStore &store, unsigned int id)
+    : _in0(store.fanin[2 * id]), _in1(store.fanin[2 * id + 1])
+{
+}
 
 CirGateHash::~CirGateHash() {}
 
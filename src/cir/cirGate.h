@@ -11,12 +11,14 @@
 
 #include <iostream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "cirDef.h"
 #include "sat.h"
 
 #define NEG 0x1
+#define NO_LIT 0xFFFFFFFF  // Unused fanin slot
 
 using namespace std;
 
@@ -24,15 +26,10 @@ using namespace std;
 //   Public Function for cirGate
 //------------------------------------------------------------------------
 
+/**
+ * @brief Phase of the literal (2 * gateId + inverted)
+ */
 bool isInv(size_t c);
-bool isInv(CirGate *c);
-unsigned int getNum(CirGate *c);
-CirGate *setNum(size_t n);
-CirGate *setNum(unsigned int n);
-CirGate *setInv(size_t c);
-CirGate *setInv(CirGate *c);
-CirGate *gate(size_t c);
-CirGate *gate(CirGate *c);
 
 //------------------------------------------------------------------------
 //   Define classes
@@ -40,29 +37,231 @@ CirGate *gate(CirGate *c);
 
 // TODO: Define your own data members and member functions, or classes
 
+/**
+ * @brief Symbolic names of the PIs and POs
+ * @details Names are interned in one pool of NUL-terminated chars, and a gate
+ * keeps only the offset of its name, in a flat array indexed by gate ID. An
+ * open-addressing table hashed by the name gives the first gate which got
+ * that name.
+ */
+class CirSymbolTable
+{
+public:
+    CirSymbolTable() : _size(0) {}
+
+    bool has(unsigned int id) const
+    {
+        return id < _offset.size() && _offset[id] != NO_LIT;
+    }
+    /**
+     * @brief Name of the gate, "" if it has none
+     */
+    const char *get(unsigned int id) const
+    {
+        return has(id) ? _pool.c_str() + _offset[id] : "";
+    }
+    /**
+     * @brief Gate named s, NO_LIT if there is none
+     */
+    unsigned int find(const string &) const;
+    /**
+     * @brief Name the gate, it must not have a name yet
+     */
+    void insert(unsigned int, const string &);
+    void clear();
+
+private:
+    static size_t hashName(const char *, size_t);
+    size_t probe(const char *, size_t) const;
+    void grow();
+
+    string _pool;  // Interned names
+    vector<unsigned int> _offset;  // Gate ID -> name in _pool, NO_LIT if none
+    vector<unsigned int> _index;   // Name hash -> gate ID, NO_LIT if empty
+    size_t _size;  // Used slots of _index
+};
+
+/**
+ * @brief Gate data of a circuit, in parallel arrays indexed by gate ID
+ * @details There is one slot per gate ID: CONST 0, PIs and AIGs in [1, M],
+ * POs in [M + 1, M + O]. CirMgr runs its algorithms on these arrays by gate
+ * ID, and a CirGate is only a view of one slot, made when it is needed.
+ */
+struct CirStore {
+    vector<unsigned char> type;  // GateType, NO_GATE for an empty slot
+    vector<unsigned int> lineNo;  // Where the gate was defined
+    vector<unsigned int> fanin;   // 2 literals per gate, NO_LIT if unused
+    CirSymbolTable symbol;  // AIGER Symbol
+    vector<unsigned int> origId;  // ID in the file read, empty until renumbered
+
+    // Fanout index in CSR form, built on demand from the fanins. An edge is
+    // kept as its fanin slot on the fanout gate, an index into fanin.
+    mutable vector<unsigned int> fanoutBeg;   // Offsets into fanoutSlot, empty if not built
+    mutable vector<unsigned int> fanoutSlot;  // Fanin slots of the fanouts, by gate ID
+    unordered_map<unsigned int, vector<unsigned int> > fanoutMoved;  // Added since the build
+
+    // Scratch data of the algorithms
+    vector<size_t> state;                 // Simulation Signal.
+    mutable vector<unsigned int> marker;  // Design for Graph search Algorithm
+    vector<Var> var;                      // SAT verification.
+
+    /**
+     * @brief Allocate n empty slots
+     */
+    void assign(size_t);
+    /**
+     * @brief Empty the slot of a removed gate
+     */
+    void erase(size_t);
+    /**
+     * @brief Release all slots
+     */
+    void clear();
+
+    bool has(size_t id) const
+    {
+        return type[id] != NO_GATE;
+    }
+    /**
+     * @brief Number of fanins, the used slots are always the first ones
+     */
+    size_t faninSize(size_t id) const
+    {
+        return (fanin[2 * id] != NO_LIT) + (fanin[2 * id + 1] != NO_LIT);
+    }
+    /**
+     * @brief Append the literal to the fanins of the gate
+     */
+    void addFanin(size_t, unsigned int);
+
+    /**
+     * @brief Live fanouts of the gate, the index is built if needed
+     */
+    void getFanout(size_t, vector<unsigned int> &) const;
+    /**
+     * @brief Fanin slots which have the gate as fanin, in getFanout() order
+     */
+    void getFanoutSlot(size_t, vector<unsigned int> &) const;
+    /**
+     * @brief Record the fanin slot rewired to the gate
+     */
+    void addFanout(size_t, unsigned int);
+    /**
+     * @brief Drop the index, it is rebuilt by the next getFanout()
+     */
+    void invalidateFanout();
+
+    /**
+     * @brief Depth first search from the literal, with an explicit stack
+     * @details pre(lit, depth) is called when a gate is reached, and returns
+     * true to visit its fanins (or fanouts) in order; post(lit, depth) is
+     * called after them. The literal has the phase of the edge it is reached
+     * by.
+     */
+    template <class Pre, class Post>
+    void traverse(unsigned int, bool, Pre, Post) const;
+
+private:
+    void buildFanout() const;
+    bool isFanout(size_t id, unsigned int slot) const
+    {
+        return fanin[slot] != NO_LIT && fanin[slot] / 2 == id;
+    }
+};
+
+template <class Pre, class Post>
+void CirStore::traverse(unsigned int root, bool toFanout, Pre pre, Post post) const
+{
+    struct Frame {
+        unsigned int lit, depth;
+        size_t beg, next, end;  // Children in kids
+    };
+    vector<Frame> stk;
+    vector<unsigned int> kids, out;
+    Frame f;
+    unsigned int lit;
+
+    if (!pre(root, 0)) {
+        return;
+    }
+
+    f.lit = root;
+    f.depth = 0;
+    do {
+        // Expand the gate reached last
+        f.beg = f.next = kids.size();
+        if (toFanout) {
+            getFanout(f.lit / 2, out);
+            kids.insert(kids.end(), out.begin(), out.end());
+        } else {
+            for (size_t i = 2 * (f.lit / 2); i < 2 * (f.lit / 2) + 2 && fanin[i] != NO_LIT; ++i) {
+                kids.push_back(fanin[i]);
+            }
+        }
+        f.end = kids.size();
+        stk.push_back(f);
+
+        // Find the next gate to expand, finishing the gates on the way
+        while (!stk.empty()) {
+            Frame &top = stk.back();
+
+            if (top.next < top.end) {
+                lit = kids[top.next++];
+                if (pre(lit, top.depth + 1)) {
+                    f.lit = lit;
+                    f.depth = top.depth + 1;
+                    break;
+                }
+            } else {
+                post(top.lit, top.depth);
+                kids.resize(top.beg);
+                stk.pop_back();
+            }
+        }
+    } while (!stk.empty());
+}
+
+/**
+ * @brief View of one gate of a CirStore
+ * @details The gate has no data of its own; every property is looked up by
+ * the gate ID in the store.
+ */
 class CirGate
 {
 public:
     friend class CirMgr;
     friend class CirGateHash;
 
-    CirGate() {}
-    CirGate(const unsigned int &id, const unsigned int &no) : _lineno(no), _gateId(id), _state(0) {}
-    virtual ~CirGate() {}
+    CirGate() : _store(0), _gateId(0) {}
+    CirGate(CirStore *store, const unsigned int &id) : _store(store), _gateId(id) {}
+    ~CirGate() {}
+
+    /**
+     * @brief False for the view of no gate, see CirMgr::getGate()
+     */
+    explicit operator bool() const
+    {
+        return _store;
+    }
 
     // Basic access methods
-    virtual string getTypeStr() const = 0;
+    string getTypeStr() const;
+    /**
+     * @brief ID of the gate in the file read, before CirMgr::compact()
+     */
+    unsigned int getOrigId() const
+    {
+        return (_store->origId.empty()) ? _gateId : _store->origId[_gateId];
+    }
     unsigned int getLineNo() const
     {
-        return _lineno;
+        return _store->lineNo[_gateId];
     }
-    virtual bool isAig() const
+    bool isAig() const
     {
-        return false;
+        return getType() == AIG_GATE;
     }
 
-    virtual void printGate() const = 0;
-
     /**
      * @brief Print type of the gate, current FECs and output value.
      * @example
@@ -73,37 +272,49 @@ public:
      * 00000000_00000000_00000000_00000000_00000000_00000000_00000000_00000000
      * ================================================================================
      */
-    virtual void reportGate() const;
+    void reportGate() const;
     /**
      * @brief Print gate fanin to ostream (cout)
      * @details Gate that have been reported before will simplified with marker (*)
      * @see CirGate::reportFanout()
      */
-    virtual void reportFanin(int level);
+    void reportFanin(int level);
     /**
      * @brief Print gate fanout to ostream (cout)
      * @details Gate that have been reported before will simplified with marker (*)
      * @see CirGate::reportFanin()
      */
-    virtual void reportFanout(int level);
+    void reportFanout(int level);
 
     // Simulation Function
-    virtual void operate();
-    virtual const size_t &getState();
-    virtual void setState(const size_t & /* state */);
+    const size_t &getState() const
+    {
+        return _store->state[_gateId];
+    }
+    void setState(const size_t &s)
+    {
+        _store->state[_gateId] = s;
+    }
 
 protected:
-    virtual void reportFanin(int level, int indent, bool invert);
-    virtual void reportFanout(int level, int indent, bool invert);
+    /**
+     * @brief Print one line of reportFanin() / reportFanout()
+     * @return bool True if the gate is expanded
+     */
+    bool reportLine(int level, unsigned int depth, bool invert, bool toFanout);
 
     // Basic Property
-    virtual bool isFloating()
+    GateType getType() const
+    {
+        return (GateType)_store->type[_gateId];
+    }
+    bool isFloating() const
     {
-        return false;
+        return getType() == UNDEF_GATE;
     }
-    virtual bool isConst()
+    bool isConst() const
     {
-        return false;
+        return getType() == CONST_GATE;
     }
 
     // Traversal Property
@@ -111,190 +322,57 @@ protected:
     {
         ++_globalMarker;
     }
-    bool hasSymbol()
-    {
-        return _symbol != "";
-    }
-    bool isMarked()
-    {
-        return _marker == _globalMarker;
-    }
-    void mark()
-    {
-        _marker = _globalMarker;
-    }
-
-    // Connection Property
-    /**
-     * @brief Append CirGate* to _fanin
-     * @param[in] c     Fanin in type CirGate*
-     * @param[in] isInv If True, store 0x1 at the LSB of CirGate*
-     * @see CirGate::disconnectFanin()
-     */
-    void addFanin(CirGate *c, bool isInv);
-    /**
-     * @brief Append CirGate* to _fanout
-     * @param[in] c     Fanin in type CirGate*
-     * @param[in] isInv If True, store 0x1 at the LSB of CirGate*
-     * @see CirGate::disconnectFanout()
-     */
-    void addFanout(CirGate *c, bool isInv);
-    /**
-     * @brief Disconnect CirGate* from _fanin
-     * @param[in] inGate Disconnect 1 if specified, disconnect all if NULL.
-     * @see CirGate::addFanin()
-     */
-    void disconnectFanin(CirGate *);
-    /**
-     * @brief Disconnect CirGate* from _fanout
-     * @param[in] outGate Disconnect 1 if specified, disconnect all if NULL.
-     * @see CirGate::addFanout()
-     */
-    void disconnectFanout(CirGate *);
-    /**
-     * @brief Disconnect all CirGate* from _fanin and _fanout
-     * @see CirGate::disconnectFanin()
-     * @see CirGate::disconnectFanout()
-     */
-    void disconnect();
-
-    // FRAIG Property
-    void setVar(const Var & /* var*/);
-    Var getVar();
-
-    static unsigned int _globalMarker;  // Design for Graph serach Algorithm
-
-    unsigned int _lineno;  // Where the gate was defined
-    unsigned int _marker;  // Design for Graph search Algorithm
-    unsigned int _gateId;  // Gate ID
-    string _symbol;        // AIGER Symbol
-    vector<CirGate *> _fanin;
-    vector<CirGate *> _fanout;
-
-    Var _var;       // SAT verification.
-    size_t _state;  // Simulation Signal.
-};
-
-class CirConstGate : public CirGate
-{
-public:
-    CirConstGate() : CirGate(0, 0) {}
-    ~CirConstGate() {}
-
-    // Basic access methods
-    string getTypeStr() const
+    bool hasSymbol() const
     {
-        return "CONST";
+        return _store->symbol.has(_gateId);
     }
-    bool isConst()
+    const char *getSymbol() const
     {
-        return true;
+        return _store->symbol.get(_gateId);
     }
-
-    // Print function
-    void printGate() const;  // Self Printing Format
-    // void reportFanin(int level) const {};  // None of Fanin
-
-    void operate();
-    const size_t &getState();
-};
-
-class CirUndefGate : public CirGate
-{
-public:
-    CirUndefGate(const unsigned int &id) : CirGate(id, 0) {}
-    ~CirUndefGate() {}
-
-    // Basic access methods
-    string getTypeStr() const
+    bool isMarked() const
     {
-        return "UNDEF";
+        return _store->marker[_gateId] == _globalMarker;
     }
-
-    // Special Designed For CirUndefGate
-    bool isFloating()
+    void mark()
     {
-        return true;
+        _store->marker[_gateId] = _globalMarker;
     }
 
-    // Print function
-    void printGate() const;
-    // void reportFanin(int level) const {};
-    // void reportFanout(int level) const {};
-
-    // void operate();
-    // const size_t& getState();
-};
-
-class CirPIGate : public CirGate
-{
-public:
-    CirPIGate(const unsigned int &id, const unsigned int &no) : CirGate(id, no) {}
-    ~CirPIGate() {}
-
-    // Basic access methods
-    string getTypeStr() const
+    // Connection Property
+    size_t faninSize() const
     {
-        return "PI";
+        return _store->faninSize(_gateId);
     }
-
-    // Print function
-    void printGate() const;  // Self Printing Format
-    // void reportFanin(int level) const {};  // None of Fanin
-};
-
-class CirPOGate : public CirGate
-{
-public:
-    CirPOGate(const unsigned int &id, const unsigned int &no) : CirGate(id, no) {}
-    ~CirPOGate() {}
-
-    // Basic access methods
-    string getTypeStr() const
+    unsigned int &fanin(size_t i) const
     {
-        return "PO";
+        return _store->fanin[2 * _gateId + i];
     }
-
-    // Print function
-    void printGate() const;  // Self Printing Format
-    // void reportFanout(int level) const {}; // None of Fanout
-
-    // Simulation function
-    void operate();
-};
-
-class CirAIGate : public CirGate
-{
-public:
-    CirAIGate(const unsigned int &id, const unsigned int &no) : CirGate(id, no) {}
-    ~CirAIGate() {}
-
-    // Basic access methods
-    string getTypeStr() const
+    /**
+     * @brief Literals of the fanout gates
+     * @see CirStore::getFanout()
+     */
+    vector<unsigned int> fanout() const
     {
-        return "AIG";
-    }
+        vector<unsigned int> out;
 
-    // Attribute
-    bool isAig() const
-    {
-        return true;
+        _store->getFanout(_gateId, out);
+        return out;
     }
 
-    // Print function
-    void printGate() const;
+    static unsigned int _globalMarker;  // Design for Graph serach Algorithm
 
-    // Simulation function
-    void operate();
+    CirStore *_store;
+    unsigned int _gateId;  // Gate ID
 };
 
 class CirGateHash
 {
 public:
     /**
-     * @param[in] c gate which has 2 fanins
+     * @param[in] id gate which has 2 fanins
      */
-    CirGateHash(CirGate *c);
+    CirGateHash(const CirStore &, unsigned int id);
     ~CirGateHash();
 
     size_t operator()() const;
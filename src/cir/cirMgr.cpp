@@ -9,6 +9,10 @@
 #include "cirMgr.h"
 
 #include <ctype.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <algorithm>
 #include <cassert>
@@ -16,6 +20,8 @@
 #include <cstring>
 #include <iomanip>
 #include <iostream>
+#include <thread>
+#include <unordered_map>
 
 #include "cirGate.h"
 #include "util.h"
@@ -57,10 +63,64 @@ enum CirParseError {
 /**************************************/
 static unsigned lineNo = 0;  // in printint, lineNo needs to ++
 static unsigned colNo = 0;   // in printing, colNo needs to ++
-static char buf[1024];
 static string errMsg;
 static int errInt;
-static CirGate *errGate;
+static CirGate errGate;
+static bool isBinary = false;  // "aig" header, AND gates are delta encoded
+
+/*
+   Parsing cursor on the mapped file. [lineBeg, lineEnd) is the current line
+   without its '\n', cur is the next char to be parsed in the line, and
+   nextLine is where the following line starts.
+*/
+static const char *lineBeg = 0;
+static const char *lineEnd = 0;
+static const char *cur = 0;
+static const char *nextLine = 0;
+static const char *bufEnd = 0;
+static CirReadBuf *inBuf = 0;  // Source of the cursor, grows when decompressing
+
+/*
+   Wait for more data of a compressed file.
+
+   @return bool
+      False if the end of the file is reached.
+*/
+static bool fillBuf()
+{
+    if (!inBuf || !inBuf->more()) {
+        return false;
+    }
+    bufEnd = inBuf->end();
+
+    return true;
+}
+
+/**
+ * @brief Decode one unsigned integer of the binary AIGER AND section.
+ * @details 7 bits per byte, LSB first; MSB set means more bytes follow.
+ * @return false if the buffer ends or the number exceeds 32 bits.
+ */
+static bool decodeDelta(const char *&p, unsigned int &x)
+{
+    unsigned int shift = 0;
+    unsigned char ch;
+
+    x = 0;
+    while (p < bufEnd || fillBuf()) {
+        ch = *p++;
+        if (shift > 28 || (shift == 28 && (ch & 0x70))) {
+            return false;
+        }
+        x |= (unsigned int)(ch & 0x7f) << shift;
+        if (!(ch & 0x80)) {
+            return true;
+        }
+        shift += 7;
+    }
+
+    return false;
+}
 
 static bool parseError(CirParseError err)
 {
@@ -117,8 +177,8 @@ static bool parseError(CirParseError err)
             break;
         case REDEF_GATE:
             cerr << "[ERROR] Line " << lineNo + 1 << ": Literal \"" << errInt
-                 << "\" is redefined, previously defined as " << errGate->getTypeStr()
-                 << " in line " << errGate->getLineNo() << "!!" << endl;
+                 << "\" is redefined, previously defined as " << errGate.getTypeStr()
+                 << " in line " << errGate.getLineNo() << "!!" << endl;
             break;
         case REDEF_SYMBOLIC_NAME:
             cerr << "[ERROR] Line " << lineNo + 1 << ": Symbolic name for \"" << errMsg << errInt
@@ -142,278 +202,827 @@ static bool parseError(CirParseError err)
     return false;
 }
 
+/*
+   Move the cursor to the next line.
+
+   @param needNewline
+      If true, the line must be terminated by '\n'.
+   @return bool
+      False if there is no (complete) line left.
+*/
+static bool getLine(bool needNewline)
+{
+    const char *p = nextLine, *nl = 0;
+
+    while (p < bufEnd || fillBuf()) {
+        if ((nl = (const char *)memchr(p, '\n', bufEnd - p))) {
+            break;
+        }
+        p = bufEnd;
+    }
+
+    if (nextLine >= bufEnd) {
+        return false;
+    } else if (!nl) {
+        if (needNewline) {
+            return false;
+        }
+        nl = bufEnd;
+    }
+
+    lineBeg = cur = nextLine;
+    lineEnd = nl;
+    nextLine = (nl == bufEnd) ? bufEnd : nl + 1;
+    colNo = 0;
+
+    return true;
+}
+
+/*
+   Same as myStr2Int(), but on the char range [b, e).
+*/
+static bool str2Int(const char *b, const char *e, int &num)
+{
+    unsigned int n = 0;
+    bool neg = (b < e && *b == '-');
+
+    if (neg) {
+        ++b;
+    }
+    if (b == e) {
+        return false;
+    }
+
+    for (; b < e; ++b) {
+        if (!isdigit((unsigned char)*b)) {
+            return false;
+        }
+        n = n * 10 + (*b - '0');
+    }
+    num = (int)(neg ? 0u - n : n);
+
+    return true;
+}
+
+/*
+   Parse the number starting at cur. On success colNo is left at the first
+   char of the number, so that the caller can report errors about its value.
+
+   @param field
+      Name of the field, for the error messages
+*/
+static bool parseNum(int &num, const char *field)
+{
+    const char *e = cur;
+
+    colNo = cur - lineBeg;
+    if (cur == lineEnd) {
+        errMsg = field;
+        return parseError(MISSING_NUM);
+    } else if (*cur == ' ') {
+        return parseError(EXTRA_SPACE);
+    } else if (isspace((unsigned char)*cur)) {
+        errInt = *cur;
+        return parseError(ILLEGAL_WSPACE);
+    }
+
+    while (e < lineEnd && !isspace((unsigned char)*e)) {
+        ++e;
+    }
+    if (!str2Int(cur, e, num) || num < 0) {
+        errMsg = string(field) + "(" + string(cur, e) + ")";
+        return parseError(ILLEGAL_NUM);
+    }
+    cur = e;
+
+    return true;
+}
+
+// Exactly one space is expected at cur
+static bool parseSpace()
+{
+    colNo = cur - lineBeg;
+    if (cur == lineEnd || *cur != ' ') {
+        return parseError(MISSING_SPACE);
+    }
+    ++cur;
+
+    return true;
+}
+
+// Nothing but the '\n' is expected at cur
+static bool parseNewline()
+{
+    colNo = cur - lineBeg;
+    if (cur != lineEnd) {
+        return parseError(MISSING_NEWLINE);
+    }
+
+    return true;
+}
+
+// The literal must not exceed the maximal variable index
+static bool checkMaxLit(int lit, unsigned int M)
+{
+    if ((unsigned int)lit / 2 > M) {
+        errInt = lit;
+        return parseError(MAX_LIT_ID);
+    }
+
+    return true;
+}
+
+/*
+   The AIG section of an ASCII file is parsed on parseThreads() threads when
+   it has at least AIG_PAR_MIN gates. A line accepted by the parallel parser
+   has at most AIG_LINE_MAX chars: "lhs rhs0 rhs1\n" of 9-digit literals.
+   A compressed file is parsed in rounds of at least AIG_ROUND_MIN bytes.
+*/
+static const unsigned int AIG_PAR_MIN = 1 << 16;
+static const unsigned int AIG_LINE_MAX = 30;
+static const size_t AIG_ROUND_MIN = 1 << 20;
+
+static unsigned int parseThreads()
+{
+    unsigned int n = thread::hardware_concurrency();
+
+    return n ? n : 1;
+}
+
+// Run f(0), ..., f(n - 1) on n threads
+template <class F>
+static void runParallel(size_t n, F f)
+{
+    vector<thread> pool;
+
+    for (size_t k = 1; k < n; ++k) {
+        pool.emplace_back(f, k);
+    }
+    f(0);
+
+    for (size_t k = 0; k < pool.size(); ++k) {
+        pool[k].join();
+    }
+}
+
+/*
+   Lines of the AIG section parsed by one thread. beg is at a line boundary,
+   and end is right after a '\n' (or the end of the section).
+*/
+struct AigChunk {
+    const char *beg;
+    const char *end;
+    size_t lines;        // Number of '\n' in [beg, end)
+    size_t line0;        // Index of the first line in the section
+    const char *aigEnd;  // Right after the last AIG line, if in this chunk
+    bool ok;
+};
+
+// Literal terminated by term. At most 9 digits, so that it fits in an int.
+static inline bool scanLit(const char *&p, const char *end, unsigned int &lit, char term)
+{
+    const char *b = p;
+    unsigned int n = 0;
+
+    for (; p < end && (unsigned char)(*p - '0') < 10; ++p) {
+        n = n * 10 + (*p - '0');
+    }
+    if (p == b || p - b > 9 || p == end || *p != term) {
+        return false;
+    }
+    ++p;
+    lit = n;
+
+    return true;
+}
+
+/*
+   Parse the AIG lines of a chunk. Only "lhs rhs0 rhs1\n" with literals in
+   range is accepted; anything else marks the chunk as not ok, and the whole
+   section is parsed again by the serial parser to report the error.
+*/
+static void scanAigChunk(AigChunk &c, size_t A, unsigned int M, unsigned int *lhs,
+                         unsigned int *rhs)
+{
+    const char *p = c.beg;
+    unsigned int l[3];
+
+    c.ok = true;
+    c.aigEnd = 0;
+    for (size_t a = c.line0; a < A && p < c.end; ++a) {
+        if (!scanLit(p, c.end, l[0], ' ') || !scanLit(p, c.end, l[1], ' ') ||
+            !scanLit(p, c.end, l[2], '\n') || l[0] / 2 > M || l[1] / 2 > M || l[2] / 2 > M) {
+            c.ok = false;
+            return;
+        }
+
+        lhs[a] = l[0];
+        rhs[2 * a] = l[1];
+        rhs[2 * a + 1] = l[2];
+        if (a + 1 == A) {
+            c.aigEnd = p;
+        }
+    }
+}
+
+/**************************************/
+/*   class CirWriteBuf member functions */
+/**************************************/
+
+CirWriteBuf::CirWriteBuf(ostream &os) : _os(os), _size(0), _buf(new char[BUF_SIZE]) {}
+
+CirWriteBuf::~CirWriteBuf()
+{
+    flush();
+    delete[] _buf;
+}
+
+void CirWriteBuf::flush()
+{
+    _os.write(_buf, _size);
+    _size = 0;
+}
+
+CirWriteBuf &CirWriteBuf::operator<<(size_t n)
+{
+    char tmp[20];
+    int len = 0;
+
+    if (_size + sizeof(tmp) > BUF_SIZE) {
+        flush();
+    }
+
+    do {
+        tmp[len++] = '0' + n % 10;
+        n /= 10;
+    } while (n);
+
+    while (len) {
+        _buf[_size++] = tmp[--len];
+    }
+
+    return *this;
+}
+
+CirWriteBuf &CirWriteBuf::operator<<(char c)
+{
+    if (_size == BUF_SIZE) {
+        flush();
+    }
+    _buf[_size++] = c;
+
+    return *this;
+}
+
+CirWriteBuf &CirWriteBuf::operator<<(const string &s)
+{
+    write(s.data(), s.size());
+
+    return *this;
+}
+
+CirWriteBuf &CirWriteBuf::operator<<(const char *s)
+{
+    return *this << string(s);
+}
+
+/*
+   Binary AIGER integer: 7 bits per byte, LSB first, MSB set if more bytes.
+*/
+void CirWriteBuf::putDelta(unsigned int x)
+{
+    if (_size + 5 > BUF_SIZE) {
+        flush();
+    }
+
+    while (x & ~0x7fu) {
+        _buf[_size++] = (char)((x & 0x7f) | 0x80);
+        x >>= 7;
+    }
+    _buf[_size++] = (char)x;
+}
+
+void CirWriteBuf::write(const void *data, size_t n)
+{
+    if (_size + n > BUF_SIZE) {
+        flush();
+    }
+
+    if (n > BUF_SIZE) {
+        _os.write((const char *)data, n);
+    } else {
+        memcpy(_buf + _size, data, n);
+        _size += n;
+    }
+}
+
+/**************************************/
+/*   class CirReadBuf member functions */
+/**************************************/
+
+CirReadBuf::~CirReadBuf()
+{
+    close();
+}
+
+/*
+   A gzip / xz file is decompressed by a background thread, begin() and
+   end() are then the decompressed part available so far.
+*/
+bool CirReadBuf::open(const string &fileName)
+{
+    struct stat st;
+    CirZipType type;
+    void *p;
+    int fd;
+
+    close();
+
+    if ((fd = ::open(fileName.c_str(), O_RDONLY)) < 0) {
+        return false;
+    }
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        return false;
+    }
+
+    _fileSize = st.st_size;
+    if (_fileSize) {
+        p = mmap(NULL, _fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            madvise(p, _fileSize, MADV_SEQUENTIAL);
+            _file = (const char *)p;
+            _mapped = true;
+        } else {
+            // Read it all when the file cannot be mapped
+            _copy.resize(_fileSize);
+            for (size_t n = 0; n < _fileSize;) {
+                ssize_t r = ::read(fd, &_copy[n], _fileSize - n);
+                if (r <= 0) {
+                    ::close(fd);
+                    close();
+                    return false;
+                }
+                n += r;
+            }
+            _file = _copy.data();
+        }
+    }
+    ::close(fd);
+
+    if ((type = cirZipType(_file, _fileSize)) != CIR_ZIP_NONE) {
+        if (!_unzip.open(_file, _fileSize, type)) {
+            close();
+            return false;
+        }
+        _zipped = true;
+        _data = _unzip.data();
+        _size = 0;
+    } else {
+        _data = _file;
+        _size = _fileSize;
+    }
+
+    return true;
+}
+
+void CirReadBuf::close()
+{
+    _unzip.close();
+    if (_mapped) {
+        munmap((void *)_file, _fileSize);
+    }
+    _copy.clear();
+    _file = _data = 0;
+    _fileSize = _size = 0;
+    _mapped = _zipped = false;
+}
+
+bool CirReadBuf::more()
+{
+    return _zipped && _unzip.wait(_size);
+}
+
+bool CirReadBuf::good()
+{
+    return !_zipped || _unzip.good();
+}
+
 /**************************************************************/
 /*   class CirMgr member functions for circuit construction   */
 /**************************************************************/
 
 /*
-   Return the pointer of specified Gate.
+   Return the view of specified Gate.
 
-   @return CirGate*
-      0 if not found
+   @return CirGate
+      A false view if not found
 */
-CirGate *CirMgr::getGate(unsigned int gid) const
+CirGate CirMgr::getGate(unsigned int gid)
 {
-    return (gid > _M + _O) ? NULL : _gates[gid];
+    return (gid > _M + _O || !_store.has(gid)) ? CirGate() : CirGate(&_store, gid);
 }
 
-bool CirMgr::readCircuit(const string &fileName)
+CirGate CirMgr::getGate(const string &name)
 {
-    // Connecting Circuit DFS Variables
-    stack<CirGate *> frontier;
+    unsigned int gid = _store.symbol.find(name);
 
-    // Parsing Circuit Variables
-    unsigned int i1, i2, i3;
-    fstream file;
-    streampos pos_o;
-    string tmp, tmp2;
-    int state;
-    char type;
+    return (gid == NO_LIT) ? CirGate() : CirGate(&_store, gid);
+}
 
-    // Open File. Check if open error
-    file.open(fileName);
+bool CirMgr::readCircuit(const string &fileName)
+{
+    CirReadBuf file;
+    bool ok;
 
-    if (!file.good()) {
+    // Open File. Check if open error
+    if (!file.open(fileName)) {
         cerr << "Cannot open design \"" << fileName << "\"!!" << endl;
-        cirMgr = NULL;
-
         return false;
     }
 
-    // Set LineNo
+    // Set LineNo and the parsing cursor
     lineNo = 0;
     colNo = 0;
+    inBuf = &file;
+    nextLine = file.begin();
+    bufEnd = file.end();
 
-    // Parsing Header
-    getline(file, tmp);
-    if (!readHeader(tmp)) {
+    // Parsing Header, then the body in ASCII or binary AIGER
+    ok = readHeader() && (isBinary ? readBinary() : readAscii());
+    inBuf = 0;
+
+    if (!file.good()) {
+        cerr << "Cannot decompress design \"" << fileName << "\"!!" << endl;
+        ok = false;
+    }
+    if (!ok) {
+        reset();
         return false;
     }
 
-    // Next Line
-    ++lineNo;
-    colNo = 0;
+    // Find out CirUNDEFGate: (floating)
+    _floating.clear();
+    getFloatingList(_floating);
+
+    // Find out NOTUSED Gate: Defined but no output connected
+    _notused.clear();
+    getNotUsedList(_notused);
+
+    return true;
+}
 
-    // Set Attribute (1 (CONST 0) + M (PI / AIG) + O (PO))
-    _gates.resize(_M + _O + 1);
-    fill(_gates.begin(), _gates.end(), (CirGate *)NULL);
+/*
+   ASCII AIGER body, parsed in a single pass over the file buffer.
 
-    // Set Gate: CONST 0
-    _gates[0] = new CirConstGate();
+   The fanin literals of POs and AIGs are recorded while parsing (a gate may
+   refer to an AIG defined later), and connected in one linear sweep after
+   the whole file has been accepted.
+*/
+bool CirMgr::readAscii()
+{
+    vector<unsigned int> lits(_O + 2 * _A);  // PO: 1 fanin literal, AIG: 2 fanin literals
+    int lit;
 
     // Set Gate: PIn
     //   Number ID of PIns in range [1, _M], Record LineNo also.
-    for (; lineNo < _I + 1; ++lineNo) {
-        getline(file, tmp);
-        state = sscanf(tmp.c_str(), "%d", &i1);
-
-        // Parsing PIns
-        if (state < 1) {
-            errMsg = "PI literal ID";
-            parseError(MISSING_NUM);
-            reset();
-            cirMgr = NULL;
-            return false;
-        } else if (state == 1 && loadInput(i1)) { /* Do nothing */
+    for (unsigned int i = 0; i < _I; ++i) {
+        ++lineNo;
+        if (!getLine(true)) {
+            errMsg = "PI";
+            return parseError(MISSING_DEF);
         }
-    }
-
-    // Set Gate: LATCH
-    //   ...
-    for (; lineNo < _I + _L + 1; ++lineNo) {
-        getline(file, tmp);
-        state = sscanf(tmp.c_str(), "%d %d", &i1, &i2);
-
-        // Parsing LATCH
-        if (state < 2) {
-            errMsg = "Latch literal ID";
-            parseError(MISSING_NUM);
-            reset();
-            cirMgr = NULL;
+        if (!parseNum(lit, "PI literal ID") || !loadInput(lit) || !parseNewline()) {
             return false;
-        } else if (state == 2 && loadLatch(i1, i2)) { /* Do nothing */
         }
     }
 
-    // Record Marker
-    pos_o = file.tellg();
-
     // Set Gate: POuts
-    //   Number ID of POs in range [_M + 1, _M + _O], and fanin is in range [0,
-    //   _M]
-    for (int o = 0; o < _O; ++o) {
-        getline(file, tmp);
-        state = sscanf(tmp.c_str(), "%d", &i1);
-
-        // Parsing
-        if (state == -1) {
-            errMsg = "PO literal ID";
-            parseError(MISSING_NUM);
-            reset();
-            cirMgr = NULL;
-            return false;
-        } else if (state < 1) {
-            parseError(MISSING_NUM);
-            reset();
-            cirMgr = NULL;
+    //   Number ID of POs in range [_M + 1, _M + _O], and fanin is in range [0, _M]
+    for (unsigned int o = 0; o < _O; ++o) {
+        ++lineNo;
+        if (!getLine(true)) {
+            errMsg = "PO";
+            return parseError(MISSING_DEF);
+        }
+        if (!parseNum(lit, "PO literal ID") || !loadOutput(_M + o + 1, lit) || !parseNewline()) {
             return false;
-        } else if (state == 1 && loadOutput(_M + o + 1, i1)) { /* Do nothing */
         }
-
-        ++lineNo;
+        lits[o] = lit;
     }
 
     // Set Gate: AIGs
-    //   Number ID of AIGs...
-    for (int a = 0; a < _A; ++a) {
-        getline(file, tmp);
-        state = sscanf(tmp.c_str(), "%d %d %d", &i1, &i2, &i3);
-
-        // Parse Error
-        if (state == 0) {
-            errMsg = "AIG literal ID";
-            parseError(MISSING_NUM);
-            reset();
-            cirMgr = NULL;
-            return false;
-        } else if (state < 3) {
-            errMsg = "AIG literal ID";
-            parseError(MISSING_NUM);
-            reset();
-            cirMgr = NULL;
-            return false;
-        } else if (state == 3 && loadAIG(i1)) { /* Do nothing */
-        }
-
-        ++lineNo;
+    if (!readAigSection(lits.data() + _O)) {
+        return false;
     }
 
     // Load Symbol and Comment, if they are at the file
-    while (true) {
-        if (file.peek() == EOF) {
-            break;
-        }  // No Symbol and Comment
+    if (!readSymbol()) {
+        return false;
+    }
 
-        if (file.peek() == 'c')  // Read Comment
-        {
-            getline(file, tmp);
+    /*
+     * Connecting AIG. Don't need to do error prevention after here.
+     *
+     * After connecting the circuit... each CirGate can see the
+     * ascenders (CirStore::fanin), the descenders are indexed on demand.
+     * Fanins that are never defined become UNDEF gates.
+     */
+    size_t k = 0;
+    for (unsigned int o = 0; o < _O; ++o) {
+        connectLit(_pout[o], lits[k++]);
+    }
+    for (unsigned int a = 0; a < _A; ++a) {
+        connectLit(_aig[a], lits[k++]);
+        connectLit(_aig[a], lits[k++]);
+    }
 
-            if (tmp != "c") {
-                parseError(ILLEGAL_IDENTIFIER);
-            }
+    return true;
+}
 
-            while (file.good()) {
-                getline(file, tmp);
-                _comment << tmp << endl;
-            }
+/*
+   AIG section of an ASCII AIGER file.
 
-            break;
-        }
+   A huge section is split into chunks at line boundaries, which are parsed
+   on several threads into per-line slots. The gates are then created and
+   checked in file order, so the circuit (and the first error reported) is
+   the same as with the serial parser.
 
-        getline(file, tmp);
-        state = sscanf(tmp.c_str(), "%c%u %s", &type, &i1, buf);
+   A compressed file is parsed in rounds: each round takes the whole lines
+   decompressed so far, while the decompressor goes on with the rest.
 
-        if (state < 3) {
-            parseError(MISSING_NUM);
-        } else if (state == 3) {
-            tmp2 = string(buf);
+   @param rhs
+      Slots for the 2 fanin literals of each AIG
+*/
+bool CirMgr::readAigSection(unsigned int *rhs)
+{
+    size_t nThread = parseThreads();
+    int lit[3];
+
+    if (nThread > 1 && _A >= AIG_PAR_MIN) {
+        vector<unsigned int> lhs(_A);
+        vector<AigChunk> chunks(nThread);
+        const size_t cap = (size_t)AIG_LINE_MAX * _A;  // Bytes of the longest section
+        const char *beg = nextLine, *end, *p;
+        const char *aigEnd = 0;
+        size_t line0 = 0;
+        bool ok = true, eof = false, last;
+
+        while (ok && !aigEnd) {
+            // Whole lines available, at least AIG_ROUND_MIN bytes of them
+            while ((size_t)(bufEnd - beg) < AIG_ROUND_MIN &&
+                   (size_t)(bufEnd - nextLine) < cap && !eof) {
+                eof = !fillBuf();
+            }
+            end = nextLine + std::min((size_t)(bufEnd - nextLine), cap);
+            last = eof || (size_t)(end - nextLine) == cap;
+            if (!last) {
+                p = (const char *)memrchr(beg, '\n', end - beg);
+                end = p ? p + 1 : beg;
+            }
+            if (beg == end) {
+                break;
+            }
 
-            if (type == 'i') {
-                if (i1 > _A) {
-                    parseError(NUM_TOO_BIG);
-                }
-                if (i1 < 0) {
-                    parseError(NUM_TOO_SMALL);
+            // Split [beg, end) at line boundaries
+            p = beg;
+            for (size_t k = 0; k < nThread; ++k) {
+                chunks[k].beg = p;
+                if (k + 1 < nThread) {
+                    p = std::max(p, beg + (end - beg) / nThread * (k + 1));
+                    p = (const char *)memchr(p, '\n', end - p);
+                    p = p ? p + 1 : end;
+                } else {
+                    p = end;
                 }
-            } else if (type == 'o') {
-                // Parsing Error
-                if (i1 > _O) {
-                    parseError(NUM_TOO_BIG);
-                }
-                if (i1 < 0) {
-                    parseError(NUM_TOO_SMALL);
+                chunks[k].end = p;
+            }
+
+            // Line index of each chunk
+            runParallel(nThread, [&chunks](size_t k) {
+                chunks[k].lines = count(chunks[k].beg, chunks[k].end, '\n');
+            });
+            chunks[0].line0 = line0;
+            for (size_t k = 1; k < nThread; ++k) {
+                chunks[k].line0 = chunks[k - 1].line0 + chunks[k - 1].lines;
+            }
+            line0 = chunks[nThread - 1].line0 + chunks[nThread - 1].lines;
+
+            // Parse
+            runParallel(nThread, [&](size_t k) {
+                scanAigChunk(chunks[k], _A, _M, lhs.data(), rhs);
+            });
+            for (size_t k = 0; k < nThread; ++k) {
+                ok = ok && chunks[k].ok;
+                aigEnd = chunks[k].aigEnd ? chunks[k].aigEnd : aigEnd;
+            }
+
+            beg = end;
+            if (last) {
+                break;
+            }
+        }
+
+        // Create the gates in order
+        if (ok && aigEnd) {
+            for (unsigned int a = 0; a < _A; ++a) {
+                ++lineNo;
+                colNo = 0;
+                if (!loadAIG(lhs[a])) {
+                    return false;
                 }
+            }
+            nextLine = aigEnd;
 
-                i1 += _M;
-            } else {
-                parseError(ILLEGAL_SYMBOL_TYPE);
-                reset();
-                cirMgr = NULL;
+            return true;
+        }
+    }
+
+    for (unsigned int a = 0; a < _A; ++a) {
+        ++lineNo;
+        if (!getLine(true)) {
+            errMsg = "AIG";
+            return parseError(MISSING_DEF);
+        }
+        if (!parseNum(lit[0], "AIG gate literal ID") || !loadAIG(lit[0])) {
+            return false;
+        }
+        for (int i = 1; i < 3; ++i) {
+            if (!parseSpace() || !parseNum(lit[i], "AIG input literal ID") ||
+                !checkMaxLit(lit[i], _M)) {
                 return false;
             }
-
-            // Load Symbol
-            loadSymbol(i1 + 1, tmp2);
-        } else {
-            break;
+            rhs[2 * a + i - 1] = lit[i];
+        }
+        if (!parseNewline()) {
+            return false;
         }
     }
 
-    /*
-     * Connecting AIG. Don't need to do error prevention after here.
-     *
-     * Before connecting the circuit... the connecting information
-     * is keeped by only CirAIGate._fanout.
-     *
-     * After connecting the circuit... each CirGate can see the
-     * ascenders (CirGate._fanin) and descenders (CirGate._fanout).
-     *
-     * - CirPOGate
-     * - CirAIGate
-     *
-     * Find out the Undefined Gate
-     *
-     * Find out the Floating Gate
-     */
+    return true;
+}
+
+/*
+   Binary AIGER body. PIs are implicit (literal 2, 4, ..., 2I), POs are ASCII
+   lines, and the AIGs are "lhs = 2 * (I + a + 1)" followed by two delta
+   codes: rhs0 = lhs - delta0, rhs1 = rhs0 - delta1.
 
-    // Reset LineNo to _I
-    lineNo = _I + 1;
+   Since rhs0, rhs1 < lhs, every fanin is created before its fanout, so the
+   AIGs are constructed and connected in one pass. POs may refer to any gate
+   and are connected once all AIGs exist.
 
-    // Load the AIG fanin information.
-    file.clear();
-    file.seekg(pos_o, ios::beg);
+   Line numbers are assigned as if the file were written in ASCII.
+*/
+bool CirMgr::readBinary()
+{
+    vector<unsigned int> lits;  // PO fanin literals
+    unsigned int lhs, delta0, delta1;
+    const char *p;
+    int lit;
 
-    // Connect POut
-    for (int o = 0; o < _O; ++o) {
-        file >> i1;
-        _gates[_M + o + 1]->addFanin(getGate(i1 / 2), i1 % 2);
-        _gates[i1 / 2]->addFanout(getGate(_M + o + 1), i1 % 2);
-    }
+    lits.reserve(_O);
 
-    // Connect And-Inverter Gate
-    for (int a = 0; a < _A; ++a) {
-        file >> i1 >> i2 >> i3;
+    // Set Gate: PIn
+    for (unsigned int i = 0; i < _I; ++i) {
+        ++lineNo;
+        loadInput(2 * (i + 1));
+    }
 
-        // if i2 or i3 is Undefined
-        if (!_gates[i2 / 2]) {
-            _gates[i2 / 2] = new CirUndefGate(i2 / 2);
+    // Set Gate: POuts
+    for (unsigned int o = 0; o < _O; ++o) {
+        ++lineNo;
+        if (!getLine(true)) {
+            errMsg = "PO";
+            return parseError(MISSING_DEF);
         }
-        if (!_gates[i3 / 2]) {
-            _gates[i3 / 2] = new CirUndefGate(i3 / 2);
+        if (!parseNum(lit, "PO literal ID") || !loadOutput(_M + o + 1, lit) || !parseNewline()) {
+            return false;
         }
+        lits.push_back(lit);
+    }
 
-        // i2 and i3 are the fanins of i1
-        _gates[i1 / 2]->addFanin(getGate(i2 / 2), i2 % 2);
-        _gates[i1 / 2]->addFanin(getGate(i3 / 2), i3 % 2);
+    // Set Gate: AIGs, decoded from the byte stream and connected on the fly
+    p = nextLine;
+    for (unsigned int a = 0; a < _A; ++a) {
+        ++lineNo;
+        lhs = 2 * (_I + a + 1);
+
+        if (!decodeDelta(p, delta0) || !decodeDelta(p, delta1)) {
+            errMsg = "AIG";
+            return parseError(MISSING_DEF);
+        } else if (!delta0 || delta0 > lhs || delta1 > lhs - delta0) {
+            errMsg = "delta code of AIG gate " + to_string(lhs);
+            return parseError(ILLEGAL_NUM);
+        }
 
-        // i1 is the fanin of i2 and i3
-        _gates[i2 / 2]->addFanout(getGate(i1 / 2), i2 % 2);
-        _gates[i3 / 2]->addFanout(getGate(i1 / 2), i3 % 2);
+        loadAIG(lhs);
+        connectLit(lhs / 2, lhs - delta0);
+        connectLit(lhs / 2, lhs - delta0 - delta1);
     }
+    nextLine = p;
 
-    // Find out CirUNDEFGate: (floating)
-    _floating.clear();
-    getFloatingList(_floating);
+    // Connect POut
+    for (unsigned int o = 0; o < _O; ++o) {
+        connectLit(_pout[o], lits[o]);
+    }
 
-    // Find out NOTUSED Gate: Defined but no output connected
-    _notused.clear();
-    getNotUsedList(_notused);
+    // Load Symbol and Comment, if they are at the file
+    return readSymbol();
+}
 
-    // Close fstream
-    file.close();
+/*
+   Symbol table and comment section, shared by ASCII and binary AIGER.
+
+   @return bool
+      False if a symbol cannot be loaded.
+*/
+bool CirMgr::readSymbol()
+{
+    const char *e;
+    int idx;
+    char type;
+
+    // A last line without '\n' is ignored
+    while (++lineNo, getLine(true)) {
+        if (cur == lineEnd) {
+            errMsg = string(1, '\0');
+            return parseError(ILLEGAL_SYMBOL_TYPE);
+        } else if (*cur == ' ') {
+            return parseError(EXTRA_SPACE);
+        } else if (isspace((unsigned char)*cur)) {
+            errInt = *cur;
+            return parseError(ILLEGAL_WSPACE);
+        }
 
-    // Sort the gate output
-    sortOut();
+        type = *cur++;
+
+        // Comment: "c" alone on its line, the rest of the file is the comment
+        if (type == 'c') {
+            if (!parseNewline()) {
+                return false;
+            }
+            while (fillBuf()) {
+            }
+            return loadComment(string(nextLine, bufEnd));
+        } else if (type != 'i' && type != 'o') {
+            errMsg = string(1, type);
+            return parseError(ILLEGAL_SYMBOL_TYPE);
+        }
+
+        // Symbol index
+        colNo = cur - lineBeg;
+        if (cur == lineEnd) {
+            errMsg = "symbol index";
+            return parseError(MISSING_NUM);
+        } else if (*cur == ' ') {
+            return parseError(EXTRA_SPACE);
+        } else if (isspace((unsigned char)*cur)) {
+            errInt = *cur;
+            return parseError(ILLEGAL_WSPACE);
+        }
+        for (e = cur; e < lineEnd && !isspace((unsigned char)*e); ++e) {
+        }
+        if (!str2Int(cur, e, idx) || idx < 0) {
+            errMsg = "symbol index(" + string(cur, e) + ")";
+            return parseError(ILLEGAL_NUM);
+        }
+        cur = e;
+
+        // Symbolic name: the rest of the line, printable chars only
+        colNo = cur - lineBeg;
+        if (cur == lineEnd) {
+            errMsg = "symbolic name";
+            return parseError(MISSING_IDENTIFIER);
+        } else if (!parseSpace()) {
+            return false;
+        } else if (cur == lineEnd) {
+            errMsg = "symbolic name";
+            return parseError(MISSING_IDENTIFIER);
+        }
+        for (e = cur; e < lineEnd; ++e) {
+            if (!isprint((unsigned char)*e)) {
+                colNo = e - lineBeg;
+                errInt = (int)(signed char)*e;
+                return parseError(ILLEGAL_SYMBOL_NAME);
+            }
+        }
+
+        if (type == 'i' && (unsigned int)idx >= _I) {
+            errMsg = "PI index";
+            errInt = idx;
+            return parseError(NUM_TOO_BIG);
+        } else if (type == 'o' && (unsigned int)idx >= _O) {
+            errMsg = "PO index";
+            errInt = idx;
+            return parseError(NUM_TOO_BIG);
+        }
+
+        errMsg = string(1, type);
+        errInt = idx;
+        if (!loadSymbol((type == 'i') ? _pin[idx] : _pout[idx], string(cur, lineEnd))) {
+            return false;
+        }
+    }
 
     return true;
 }
@@ -422,18 +1031,16 @@ bool CirMgr::readCircuit(const string &fileName)
 void CirMgr::getFloatingList(vector<unsigned int> &floating)
 {
     for (size_t i = 0; i < _aig.size(); ++i) {
-        for (vector<CirGate *>::iterator it2 = getGate(_aig[i])->_fanin.begin();
-             it2 != getGate(_aig[i])->_fanin.end(); ++it2) {
-            if (gate(*it2)->isFloating()) {
+        for (size_t j = 2 * _aig[i]; j < 2 * _aig[i] + 2; ++j) {
+            if (_store.fanin[j] != NO_LIT && _store.type[_store.fanin[j] / 2] == UNDEF_GATE) {
                 floating.push_back(_aig[i]);
             }
         }
     }
 
     for (size_t i = 0; i < _pout.size(); ++i) {
-        for (vector<CirGate *>::iterator it2 = getGate(_pout[i])->_fanin.begin();
-             it2 != getGate(_pout[i])->_fanin.end(); ++it2) {
-            if (gate(*it2)->isFloating()) {
+        for (size_t j = 2 * _pout[i]; j < 2 * _pout[i] + 2; ++j) {
+            if (_store.fanin[j] != NO_LIT && _store.type[_store.fanin[j] / 2] == UNDEF_GATE) {
                 floating.push_back(_pout[i]);
             }
         }
@@ -444,14 +1051,23 @@ void CirMgr::getFloatingList(vector<unsigned int> &floating)
 
 void CirMgr::getNotUsedList(vector<unsigned int> &notused)
 {
+    vector<bool> used(_store.type.size(), false);
+
+    // A gate is used if it is the fanin of any gate
+    for (size_t i = 0; i < _store.fanin.size(); ++i) {
+        if (_store.fanin[i] != NO_LIT) {
+            used[_store.fanin[i] / 2] = true;
+        }
+    }
+
     for (size_t i = 0; i < _aig.size(); ++i) {
-        if (!getGate(_aig[i])->_fanout.size()) {
+        if (!used[_aig[i]]) {
             notused.push_back(_aig[i]);
         }
     }
 
     for (size_t i = 0; i < _pin.size(); ++i) {
-        if (!getGate(_pin[i])->_fanout.size()) {
+        if (!used[_pin[i]]) {
             notused.push_back(_pin[i]);
         }
     }
@@ -459,7 +1075,7 @@ void CirMgr::getNotUsedList(vector<unsigned int> &notused)
     ::sort(notused.begin(), notused.end());
 }
 
-const vector<vector<CirGate *> > &CirMgr::getFECGroups() const
+const vector<vector<unsigned int> > &CirMgr::getFECGroups() const
 {
     return FECs;
 }
@@ -482,11 +1098,8 @@ void CirMgr::printSummary() const
 
 void CirMgr::printNetlist() const
 {
-    vector<CirGate *> dfslist;
-    CirGate *tmp;
-
-    // Raise Up Global Marker
-    CirGate::raiseGlobalMarker();
+    const vector<unsigned int> &dfslist = dfsList();
+    CirGate g, tmp;
 
     // Reset lineNo
     lineNo = 0;
@@ -494,36 +1107,36 @@ void CirMgr::printNetlist() const
     // Pre-spacing
     cout << endl;
 
-    // Depth First Traversal from all POut
-    for (size_t i = 0; i < _pout.size(); ++i) {
-        DepthFirstTraversal(_pout[i], dfslist);
-    }
-
     // Print by the priority of dfslist
-    for (vector<CirGate *>::iterator it = dfslist.begin(); it != dfslist.end(); ++it) {
-        cout << '[' << lineNo << "] " << setw(4) << left << (*it)->getTypeStr() << (*it)->_gateId;
+    for (vector<unsigned int>::const_iterator it = dfslist.begin(); it != dfslist.end(); ++it) {
+        g = view(*it);
+        cout << '[' << lineNo << "] " << setw(4) << left << g.getTypeStr() << g._gateId;
 
-        for (vector<CirGate *>::iterator it2 = (*it)->_fanin.begin(); it2 != (*it)->_fanin.end();
-             ++it2) {
-            tmp = gate(*it2);
+        for (size_t i = 0; i < g.faninSize(); ++i) {
+            tmp = view(g.fanin(i) / 2);
 
             cout << ' ';
 
             // Print "*" for floating gate, "!" for inverted gates
-            if (tmp->isFloating()) {
+            if (tmp.isFloating()) {
                 cout << '*';
             }
 
-            if (isInv(*it2)) {
+            if (isInv(g.fanin(i))) {
                 cout << '!';
             }
 
-            cout << tmp->_gateId;
+            cout << tmp._gateId;
         }
 
         // Print Symbol if needed.
-        if ((*it)->hasSymbol()) {
-            cout << " (" << (*it)->_symbol << ')';
+        if (g.hasSymbol()) {
+            cout << " (" << g.getSymbol() << ')';
+        }
+
+        // Print the ID in the file read after CIRCompact
+        if (g.getOrigId() != g._gateId) {
+            cout << " (was " << g.getOrigId() << ')';
         }
 
         cout << endl;
@@ -585,7 +1198,10 @@ void CirMgr::printFECPairs() const
         cout << '[' << i << ']';
 
         for (size_t j = 0; j < FECs[i].size(); ++j) {
-            cout << ' ' << FECs[i][j]->_gateId;
+            cout << ' ' << FECs[i][j] / 2;
+            if (view(FECs[i][j] / 2).getOrigId() != FECs[i][j] / 2) {
+                cout << " (was " << view(FECs[i][j] / 2).getOrigId() << ')';
+            }
         }
 
         cout << endl;
@@ -594,245 +1210,413 @@ void CirMgr::printFECPairs() const
 
 void CirMgr::reset()
 {
-    vector<CirGate *>::iterator end = _gates.end();
+    _M = _I = _L = _O = _A = _removed = 0;
 
-    _M = _I = _L = _O = _A = 0;
+    _store.clear();
+    invalidateDfsList();
 
-    for (vector<CirGate *>::iterator it = _gates.begin(); it != end; ++it) {
-        delete (*it);
-    }
-
-    cirMgr = NULL;
+    _pin.clear();
+    _pout.clear();
+    _aig.clear();
+    _floating.clear();
+    _notused.clear();
+    FECs.clear();
+    _comment.str("");
 }
 
 void CirMgr::writeAag(ostream &outfile) const
 {
-    vector<CirGate *> dfslist;
+    const vector<unsigned int> &dfslist = dfsList();  // Output + AIG + Input
+    CirWriteBuf out(outfile);
     size_t activeAIG = 0;
-    CirGate *tmp;
-
-    // Output + AIG + Input (With DFS order)
-    CirGate::raiseGlobalMarker();
-    for (size_t i = 0; i < _pout.size(); ++i) {
-        DepthFirstTraversal(getGate(_pout[i]), dfslist);
-    }
 
     // Count number of AIG.
-    for (vector<CirGate *>::iterator it = dfslist.begin(); it != dfslist.end(); ++it) {
-        if ((*it)->_fanin.size() && (*it)->_fanout.size()) {
+    for (vector<unsigned int>::const_iterator it = dfslist.begin(); it != dfslist.end(); ++it) {
+        if (_store.type[*it] == AIG_GATE) {
             ++activeAIG;
         }
     }
 
     // Header
-    outfile << "aag " << _M << " " << _I << " " << _L << " " << _O << " " << activeAIG << endl;
+    out << "aag " << _M << ' ' << _I << ' ' << _L << ' ' << _O << ' ' << activeAIG << '\n';
 
     // Input
     for (size_t i = 0; i < _pin.size(); ++i) {
-        outfile << 2 * _pin[i] << endl;
+        out << 2 * _pin[i] << '\n';
     }
 
     // Output
     for (size_t i = 0; i < _pout.size(); ++i) {
-        tmp = getGate(_pout[i])->_fanin[0];
-        outfile << ((isInv(tmp)) ? (2 * gate(tmp)->_gateId + 1) : (2 * tmp->_gateId)) << endl;
+        out << _store.fanin[2 * _pout[i]] << '\n';
     }
 
     // AIG (Print the dfslist)
-    for (vector<CirGate *>::iterator it = dfslist.begin(); it != dfslist.end(); ++it) {
+    for (vector<unsigned int>::const_iterator it = dfslist.begin(); it != dfslist.end(); ++it) {
         // Check if it is an AIG
-        if ((*it)->_fanin.size() && (*it)->_fanout.size()) {
-            outfile << 2 * (*it)->_gateId;
-            for (vector<CirGate *>::iterator it2 = (*it)->_fanin.begin();
-                 it2 != (*it)->_fanin.end(); ++it2) {
-                outfile << ' '
-                        << ((isInv(*it2)) ? (2 * gate(*it2)->_gateId + 1) : (2 * (*it2)->_gateId));
+        if (_store.type[*it] == AIG_GATE) {
+            out << 2 * *it;
+            for (size_t i = 0; i < _store.faninSize(*it); ++i) {
+                out << ' ' << _store.fanin[2 * *it + i];
             }
-            outfile << endl;
+            out << '\n';
         }
     }
 
     // Symbol
-    for (size_t i = 0; i < _pin.size(); ++i) {
-        tmp = getGate(_pin[i]);
-        if (tmp->hasSymbol()) {
-            outfile << 'i' << i << ' ' << tmp->_symbol << endl;
-        }
-    }
-
-    for (size_t o = 0; o < _pout.size(); ++o) {
-        tmp = getGate(_pout[o]);
-        if (tmp->hasSymbol()) {
-            outfile << 'o' << o << ' ' << tmp->_symbol << endl;
-        }
-    }
+    writeSymbol(out);
 
     // Comment (Just for fun!)
     // if (_comment.good())
     //    outfile << 'c' << endl << _comment.str();
 
     // Comment (For vimdiff)
-    outfile << 'c' << endl << "AAG output by Chung-Yang (Ric) Huang" << endl;
+    out << "c\nAAG output by Chung-Yang (Ric) Huang\n";
 }
 
-void CirMgr::writeGate(ostream &outfile, CirGate *g) const {}
-
-/**********************************************************/
-/*   HELPER FUNCTION                                      */
-/**********************************************************/
+/*
+   Binary AIGER writer. Gates are renumbered as AIGER requires:
+   PIs are 1..I in _pin order, then the active AIGs in DFS order, so both
+   fanins of an AIG always have smaller literals. Each AIG is written as
+   2 delta codes: lhs - rhs0 and rhs0 - rhs1, where rhs0 >= rhs1.
 
-void CirMgr::connect(CirGate *prev, CirGate *next)
+   UNDEF fanins are not representable in binary AIGER, they are written
+   as CONST 0 (which is also their value in simulation).
+*/
+void CirMgr::writeAig(ostream &outfile) const
 {
-    gate(prev)->addFanout(gate(next), isInv(prev) ^ isInv(next));
-    gate(next)->addFanin(gate(prev), isInv(prev) ^ isInv(next));
+    const vector<unsigned int> &dfslist = dfsList();  // Output + AIG + Input
+    vector<unsigned int> aigs;
+    vector<unsigned int> newId(_M + 1, 0);
+    CirWriteBuf out(outfile);
+    unsigned int lhs, rhs0, rhs1, tmp;
+
+    // Renumbering: PIs first, then active AIGs in DFS order
+    for (size_t i = 0; i < _pin.size(); ++i) {
+        newId[_pin[i]] = i + 1;
+    }
+    for (vector<unsigned int>::const_iterator it = dfslist.begin(); it != dfslist.end(); ++it) {
+        if (_store.type[*it] == AIG_GATE) {
+            aigs.push_back(*it);
+            newId[*it] = _I + aigs.size();
+        }
+    }
+
+    // Header
+    out << "aig " << _I + aigs.size() << ' ' << _I << " 0 " << _O << ' ' << aigs.size() << '\n';
+
+    // Output
+    for (size_t i = 0; i < _pout.size(); ++i) {
+        tmp = _store.fanin[2 * _pout[i]];
+        out << 2 * newId[tmp / 2] + isInv(tmp) << '\n';
+    }
+
+    // AIG
+    for (size_t a = 0; a < aigs.size(); ++a) {
+        lhs = 2 * (_I + a + 1);
+        tmp = _store.fanin[2 * aigs[a]];
+        rhs0 = 2 * newId[tmp / 2] + isInv(tmp);
+        tmp = _store.fanin[2 * aigs[a] + 1];
+        rhs1 = 2 * newId[tmp / 2] + isInv(tmp);
+
+        if (rhs0 < rhs1) {
+            swap(rhs0, rhs1);
+        }
+
+        out.putDelta(lhs - rhs0);
+        out.putDelta(rhs0 - rhs1);
+    }
+
+    // Symbol
+    writeSymbol(out);
+
+    // Comment (For vimdiff)
+    out << "c\nAIG output by Chung-Yang (Ric) Huang\n";
 }
 
-void CirMgr::sortInOut()
+/*
+   Symbol table of PIs and POs, shared by all writers.
+*/
+void CirMgr::writeSymbol(CirWriteBuf &out) const
 {
-    sortIn();
-    sortOut();
+    for (size_t i = 0; i < _pin.size(); ++i) {
+        if (_store.symbol.has(_pin[i])) {
+            out << 'i' << i << ' ' << _store.symbol.get(_pin[i]) << '\n';
+        }
+    }
+
+    for (size_t o = 0; o < _pout.size(); ++o) {
+        if (_store.symbol.has(_pout[o])) {
+            out << 'o' << o << ' ' << _store.symbol.get(_pout[o]) << '\n';
+        }
+    }
 }
 
 /*
-   Sorting _fanin of CirAIGate
+   Write the transitive fanin cone of g as a standalone AAG, with g as the
+   only PO. The cone is renumbered compactly: PIs 1..I in the PI order of
+   the circuit, then the AIGs in DFS order. Undefined fanins are written as
+   CONST 0. The PO symbol keeps the original gate ID.
+
+   The traversal and the renumbering only touch the gates of the cone.
 */
-void CirMgr::sortIn()
+void CirMgr::writeGate(ostream &outfile, unsigned int g) const
 {
-    for (unsigned int i = 0; i < _M; ++i) {
-        if (_gates[i]) {
-            ::sort(_gates[i]->_fanin.begin(), _gates[i]->_fanin.end(),
-                   [](CirGate *a, CirGate *b) { return gate(a)->_gateId < gate(b)->_gateId; });
+    vector<unsigned int> dfslist, pis, aigs;
+    unordered_map<unsigned int, unsigned int> newId;  // Original ID -> ID in the cone
+    unordered_map<unsigned int, unsigned int>::const_iterator found;
+    CirWriteBuf out(outfile);
+
+    // Literal of the fanin c in the cone
+    auto lit = [&](unsigned int c) {
+        found = newId.find(c / 2);
+        return 2 * ((found == newId.end()) ? 0 : found->second) + isInv(c);
+    };
+
+    CirGate::raiseGlobalMarker();
+    DepthFirstTraversal(g, dfslist);
+
+    for (vector<unsigned int>::iterator it = dfslist.begin(); it != dfslist.end(); ++it) {
+        if (_store.faninSize(*it)) {
+            aigs.push_back(*it);
+        } else if (_store.type[*it] != CONST_GATE) {
+            pis.push_back(*it);
+        }
+    }
+
+    // PIs are defined in order of their line number
+    ::sort(pis.begin(), pis.end(), [this](unsigned int a, unsigned int b) {
+        return _store.lineNo[a] < _store.lineNo[b];
+    });
+    for (size_t i = 0; i < pis.size(); ++i) {
+        newId[pis[i]] = i + 1;
+    }
+    for (size_t a = 0; a < aigs.size(); ++a) {
+        newId[aigs[a]] = pis.size() + a + 1;
+    }
+
+    // Header
+    out << "aag " << pis.size() + aigs.size() << ' ' << pis.size() << " 0 1 " << aigs.size()
+        << '\n';
+
+    // Input
+    for (size_t i = 0; i < pis.size(); ++i) {
+        out << 2 * (i + 1) << '\n';
+    }
+
+    // Output
+    out << lit(2 * g) << '\n';
+
+    // AIG
+    for (size_t a = 0; a < aigs.size(); ++a) {
+        out << 2 * (pis.size() + a + 1);
+        for (size_t i = 0; i < _store.faninSize(aigs[a]); ++i) {
+            out << ' ' << lit(_store.fanin[2 * aigs[a] + i]);
         }
+        out << '\n';
     }
+
+    // Symbol
+    for (size_t i = 0; i < pis.size(); ++i) {
+        if (_store.symbol.has(pis[i])) {
+            out << 'i' << i << ' ' << _store.symbol.get(pis[i]) << '\n';
+        }
+    }
+    out << "o0 " << g << '\n';
+
+    // Comment
+    out << "c\nWrite gate (" << g << ") by Chung-Yang (Ric) Huang\n";
 }
 
+/**********************************************************/
+/*   HELPER FUNCTION                                      */
+/**********************************************************/
+
 /*
-   Sorting _fanout of CirAIGate, CirPIGate and CirConstGate
+   Sorting the fanins of AIG gates
 */
-void CirMgr::sortOut()
+void CirMgr::sortIn()
 {
+    unsigned int *in;
+
     for (unsigned int i = 0; i < _M; ++i) {
-        if (_gates[i]) {
-            ::sort(_gates[i]->_fanout.begin(), _gates[i]->_fanout.end(),
-                   [](CirGate *a, CirGate *b) { return gate(a)->_gateId < gate(b)->_gateId; });
+        in = &_store.fanin[2 * i];
+        if (in[1] != NO_LIT && in[1] / 2 < in[0] / 2) {
+            swap(in[0], in[1]);
         }
     }
 }
 
 /*
-   Overloading of DepthFirstSearch Algorithm.
+   DepthFirstSearch Algorithm, with the explicit stack of
+   CirStore::traverse(), so that deep cones do not overflow the call stack.
+   Search gates from POut(s) to PIn(s); marked and floating gates are
+   skipped.
 
    @param gateID
       The gateID to start searching.
    @param dfslist
-      The gateID List
+      The gate IDs of the cone, fanins first
 */
-void CirMgr::DepthFirstTraversal(const unsigned int gateID, vector<CirGate *> &dfslist) const
+void CirMgr::DepthFirstTraversal(const unsigned int gateID, vector<unsigned int> &dfslist) const
 {
-    DepthFirstTraversal(getGate(gateID), dfslist);
+    _store.traverse(
+        2 * gateID, false,
+        [&](unsigned int lit, unsigned int) {
+            unsigned int g = lit / 2;
+
+            // If have already seen the element, ignore it
+            if (_store.marker[g] == CirGate::_globalMarker || _store.type[g] == UNDEF_GATE) {
+                return false;
+            }
+            _store.marker[g] = CirGate::_globalMarker;
+            return true;
+        },
+        [&](unsigned int lit, unsigned int) { dfslist.push_back(lit / 2); });
 }
 
 /*
-   DepthFirstSearch Algorithm, implemented by recursive.
-   Search gates from POut(s) to PIn(s).
-
-   @param c
-      The start point of CirGate
-   @param dfslist
-      The gateID List
+   The DFS from all POs is cached until a structural edit of the PO cones.
 */
-void CirMgr::DepthFirstTraversal(CirGate *c, vector<CirGate *> &dfslist) const
+const vector<unsigned int> &CirMgr::dfsList() const
 {
-    // If have already seen the element, ignore it
-    if (c->isMarked() || c->isFloating()) {
-        return;
+    if (_dfsValid) {
+        return _dfsList;
     }
 
-    // Mark the Gate
-    c->mark();
+    _dfsList.clear();
+    CirGate::raiseGlobalMarker();
+    for (size_t i = 0; i < _pout.size(); ++i) {
+        DepthFirstTraversal(_pout[i], _dfsList);
+    }
 
-    // Left -> Rigth -> Center
-    for (vector<CirGate *>::iterator it = c->_fanin.begin(); it != c->_fanin.end(); ++it) {
-        DepthFirstTraversal(gate(*it), dfslist);
+    _dfsPos.assign(_store.type.size(), NO_LIT);
+    for (size_t i = 0; i < _dfsList.size(); ++i) {
+        _dfsPos[_dfsList[i]] = i;
     }
+    _dfsValid = true;
 
-    dfslist.push_back(c);
+    return _dfsList;
 }
 
-bool CirMgr::readHeader(const string &s)
+void CirMgr::invalidateDfsList()
 {
-    int state = sscanf(s.c_str(), "%s %d %d %d %d %d", buf, &_M, &_I, &_L, &_O, &_A);
+    _dfsValid = false;
+    _simProgValid = false;
+    vector<unsigned int>().swap(_dfsList);
+    vector<unsigned int>().swap(_dfsPos);
+}
 
-    if (s.find('\t') != string::npos) {
-        errInt = '\t';
-        colNo += s.find('\t');
-        parseError(ILLEGAL_WSPACE);
-    } else if (state == -1) {
-        colNo = s.length();
-        parseError(MISSING_NUM);
-    } else if (state < 6) {
-        if (string(buf) != "aag") {
-            errMsg = string(buf);
-            parseError(ILLEGAL_IDENTIFIER);
-        } else {
-            colNo = s.length();
-            errMsg = "number of variables";
-            parseError(MISSING_NUM);
-        }
-    } else if (state == 6) {
-        if (s[0] == ' ') {
-            parseError(EXTRA_SPACE);
-        } else if (s[0] != 'a') {
-            errInt = s[0];
-            parseError(ILLEGAL_WSPACE);
-        } else if (string(buf) != "aag") {
-            errMsg = "";
-            parseError(ILLEGAL_IDENTIFIER);
-        } else if (count(s.begin(), s.end(), ' ') > 5) {
-            for (int i = 0; i < 6; ++i) {
-                colNo = s.find(' ', ++colNo);
-            }
-            parseError(MISSING_NEWLINE);
-        } else if (_M < _I + _A) {
-            errInt = _M;
-            parseError(NUM_TOO_SMALL);
+/*
+   A gate outside the PO cones, as sweep removes, has no fanout in them
+   either, so the list stays valid.
+
+   @param id
+      The gate to be merged or removed
+*/
+void CirMgr::invalidateDfsList(unsigned int id)
+{
+    if (_dfsValid && _dfsPos[id] != NO_LIT) {
+        invalidateDfsList();
+    }
+}
+
+/*
+   Parse the header "aag M I L O A" (or "aig ...") at the first line, and
+   allocate the gate table (1 (CONST 0) + M (PI / AIG) + O (PO)).
+*/
+bool CirMgr::readHeader()
+{
+    static const char *fields[5] = {"number of variables", "number of PIs", "number of latches",
+                                    "number of POs", "number of AIGs"};
+    const char *e;
+    int num[5];
+
+    if (!getLine(false) || lineBeg == lineEnd) {
+        errMsg = "aag";
+        return parseError(MISSING_IDENTIFIER);
+    } else if (*cur == ' ') {
+        return parseError(EXTRA_SPACE);
+    } else if (isspace((unsigned char)*cur)) {
+        errInt = *cur;
+        return parseError(ILLEGAL_WSPACE);
+    }
+
+    // Identifier
+    for (e = cur; e < lineEnd && !isspace((unsigned char)*e) && !isdigit((unsigned char)*e); ++e) {
+    }
+    errMsg = string(cur, e);
+    if (errMsg != "aag" && errMsg != "aig") {
+        return parseError(ILLEGAL_IDENTIFIER);
+    }
+    isBinary = (errMsg == "aig");
+    cur = e;
+
+    // M I L O A
+    for (int i = 0; i < 5; ++i) {
+        if (cur != lineEnd && !parseSpace()) {
+            return false;
+        }
+        if (!parseNum(num[i], fields[i])) {
+            return false;
         }
+    }
+    if (!parseNewline()) {
+        return false;
+    }
 
-        return true;
+    _M = num[0];
+    _I = num[1];
+    _L = num[2];
+    _O = num[3];
+    _A = num[4];
+
+    if (_L) {
+        errMsg = "latches";
+        return parseError(ILLEGAL_NUM);
+    } else if (_M < _I + _L + _A) {
+        errMsg = "Number of variables";
+        errInt = _M;
+        return parseError(NUM_TOO_SMALL);
+    } else if (isBinary && _M != _I + _L + _A) {
+        errMsg = "Number of variables";
+        errInt = _M;
+        return parseError(NUM_TOO_BIG);
     }
 
-    reset();
-    cirMgr = NULL;
-    return false;
+    _store.assign(_M + _O + 1);
+    newGate(CONST_GATE, 0, 0);
+
+    return true;
 }
 
 /*
    Input pin will have no fanin, but multiple fanout
 
    @param id
-      The ID Number of the Gate
+      The literal of the Gate
    @return bool
       True if successfully load a PIn
 */
 bool CirMgr::loadInput(const unsigned int &id)
 {
     // Parsing Error
-    if (id > 2 * _M) {
+    if (id / 2 > _M) {
         errInt = id;
         parseError(MAX_LIT_ID);
-    } else if (id == 0) {
+    } else if (id < 2) {
         errInt = id;
         parseError(REDEF_CONST);
-    } else if (id == 1) {
+    } else if (id % 2) {
+        errMsg = "PI";
         errInt = id;
-        parseError(REDEF_CONST);
-    } else if (_gates[id / 2]) {
+        parseError(CANNOT_INVERTED);
+    } else if (_store.has(id / 2)) {
         errInt = id;
-        errGate = _gates[id / 2];
+        errGate = CirGate(&_store, id / 2);
         parseError(REDEF_GATE);
     } else {
         _pin.push_back(id / 2);
-        _gates[id / 2] = new CirPIGate(id / 2, lineNo + 1);
+        newGate(PI_GATE, id / 2, lineNo + 1);
 
         return true;
     }
@@ -843,10 +1627,10 @@ bool CirMgr::loadInput(const unsigned int &id)
 bool CirMgr::loadOutput(const unsigned int &id, const unsigned int &fanin)
 {
     // Parsing Error
-    if (false) {
+    if (!checkMaxLit(fanin, _M)) {
     } else {
         _pout.push_back(id);
-        _gates[id] = new CirPOGate(id, lineNo + 1);
+        newGate(PO_GATE, id, lineNo + 1);
 
         return true;
     }
@@ -857,21 +1641,23 @@ bool CirMgr::loadOutput(const unsigned int &id, const unsigned int &fanin)
 bool CirMgr::loadAIG(const unsigned int &id)
 {
     // Parsing Error
-    if (id > 2 * _M) {
-        parseError(NUM_TOO_BIG);
-    } else if (id == 0) {
-        parseError(REDEF_CONST);
-    } else if (id == 1) {
+    if (id / 2 > _M) {
+        errInt = id;
+        parseError(MAX_LIT_ID);
+    } else if (id < 2) {
+        errInt = id;
         parseError(REDEF_CONST);
     } else if (id % 2) {
+        errMsg = "AIG gate";
+        errInt = id;
         parseError(CANNOT_INVERTED);
-    } else if (_gates[id / 2]) {
+    } else if (_store.has(id / 2)) {
         errInt = id;
-        errGate = _gates[id / 2];
+        errGate = CirGate(&_store, id / 2);
         parseError(REDEF_GATE);
     } else {
         _aig.push_back(id / 2);
-        _gates[id / 2] = new CirAIGate(id / 2, lineNo + 1);
+        newGate(AIG_GATE, id / 2, lineNo + 1);
 
         return true;
     }
@@ -879,13 +1665,28 @@ bool CirMgr::loadAIG(const unsigned int &id)
     return false;
 }
 
-bool CirMgr::loadLatch(const unsigned int &Q, const unsigned int &nextQ)
+/*
+   Connect the fanin literal to the gate g, the fanin is created as an
+   UNDEF gate if it is not defined.
+*/
+void CirMgr::connectLit(unsigned int id, const unsigned int &lit)
 {
-    return true;
+    if (!_store.has(lit / 2)) {
+        newGate(UNDEF_GATE, lit / 2, 0);
+    }
+
+    _store.addFanin(id, lit);
+}
+
+void CirMgr::newGate(GateType type, const unsigned int &id, const unsigned int &no)
+{
+    _store.type[id] = type;
+    _store.lineNo[id] = no;
 }
 
 /*
-   Load the symbol
+   Load the symbol. errMsg and errInt are set by the caller for the
+   redefinition message.
 
    @param id
       The ID Number of the gate
@@ -895,10 +1696,10 @@ bool CirMgr::loadLatch(const unsigned int &Q, const unsigned int &nextQ)
 bool CirMgr::loadSymbol(const unsigned int &id, const string &s)
 {
     // Parsing Error
-    if (_gates[id]->hasSymbol())
+    if (_store.symbol.has(id))
         parseError(REDEF_SYMBOLIC_NAME);
     else {
-        _gates[id]->_symbol = s;
+        _store.symbol.insert(id, s);
 
         return true;
     }
@@ -908,5 +1709,7 @@ bool CirMgr::loadSymbol(const unsigned int &id, const string &s)
 
 bool CirMgr::loadComment(const string &s)
 {
+    _comment.str(s);
+
     return true;
 }
@@ -10,32 +10,360 @@
 #define CIR_MGR_H
 
 #include <algorithm>
+#include <condition_variable>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <mutex>
 #include <sstream>
 #include <stack>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "cirDef.h"
+#include "cirGate.h"
+#include "cirNative.h"
+#include "cirZip.h"
 #include "rnGen.h"
 
 // TODO: Feel free to define your own classes, variables, or functions.
 
 extern CirMgr *cirMgr;
 
+/**
+ * @brief Output buffer of the circuit writers
+ * @details Collects the text / binary output and releases it to the ostream
+ * in blocks of BUF_SIZE bytes, instead of flushing every line with endl.
+ */
+class CirWriteBuf
+{
+public:
+    CirWriteBuf(std::ostream &);
+    ~CirWriteBuf();
+
+    CirWriteBuf &operator<<(size_t);
+    CirWriteBuf &operator<<(unsigned int n)
+    {
+        return *this << (size_t)n;
+    }
+    CirWriteBuf &operator<<(char);
+    CirWriteBuf &operator<<(const std::string &);
+    CirWriteBuf &operator<<(const char *);
+    /**
+     * @brief Append an unsigned integer in binary AIGER (7-bit) encoding
+     */
+    void putDelta(unsigned int);
+    /**
+     * @brief Append raw bytes
+     */
+    void write(const void *, size_t);
+    void flush();
+
+private:
+    static const size_t BUF_SIZE = 1 << 20;
+
+    CirWriteBuf(const CirWriteBuf &);
+    CirWriteBuf &operator=(const CirWriteBuf &);
+
+    std::ostream &_os;
+    size_t _size;
+    char *_buf;
+};
+
+/**
+ * @brief Input buffer of the circuit readers
+ * @details The whole file is mapped into memory (or read at once if it
+ * cannot be mapped), so that the parser can scan it with plain pointers.
+ * A gzip / xz file is decompressed in the background while being parsed;
+ * more() waits for the next decompressed block.
+ */
+class CirReadBuf
+{
+public:
+    CirReadBuf() : _file(0), _fileSize(0), _data(0), _size(0), _mapped(false), _zipped(false) {}
+    ~CirReadBuf();
+
+    bool open(const std::string &);
+    void close();
+
+    const char *begin() const
+    {
+        return _data;
+    }
+    const char *end() const
+    {
+        return _data + _size;
+    }
+    /**
+     * @brief Extend end() with newly decompressed data
+     * @return false if the end of the file is reached
+     */
+    bool more();
+    /**
+     * @brief False if the file failed to decompress
+     */
+    bool good();
+    /**
+     * @brief Decompress the rest of the file, for callers that need all of it
+     * @return good()
+     */
+    bool readAll()
+    {
+        while (more()) {
+        }
+        return good();
+    }
+
+private:
+    CirReadBuf(const CirReadBuf &);
+    CirReadBuf &operator=(const CirReadBuf &);
+
+    const char *_file;  // Content of the file, maybe compressed
+    size_t _fileSize;
+    const char *_data;  // Content to be parsed
+    size_t _size;
+    bool _mapped;
+    bool _zipped;
+    std::string _copy;  // Used when the file cannot be mapped
+    CirUnzip _unzip;
+};
+
+/**
+ * @brief Input buffer of the simulation pattern files
+ * @details Reads the istream in blocks of BUF_SIZE bytes and hands out one
+ * line at a time, so a pattern file is never held in memory as a whole.
+ */
+class CirPatternBuf
+{
+public:
+    CirPatternBuf(std::istream &is) : _is(is), _buf(BUF_SIZE), _beg(0), _end(0), _eof(false) {}
+
+    /**
+     * @brief Get the next line [b, e), without the newline
+     * @return false if the end of the stream is reached
+     */
+    bool getLine(const char *& /* b */, const char *& /* e */);
+    /**
+     * @brief Look at the next n bytes without consuming them
+     * @return NULL if the stream has less than n bytes left
+     */
+    const char *peek(size_t);
+    /**
+     * @brief Consume the next n bytes, valid until the next call
+     * @return NULL if the stream has less than n bytes left
+     */
+    const char *get(size_t);
+
+private:
+    static const size_t BUF_SIZE = 1 << 20;
+
+    CirPatternBuf(const CirPatternBuf &);
+    CirPatternBuf &operator=(const CirPatternBuf &);
+
+    bool fill();
+
+    std::istream &_is;
+    std::vector<char> _buf;
+    size_t _beg;  // Unread data is [_beg, _end)
+    size_t _end;
+    bool _eof;
+};
+
+/**
+ * @brief Writer thread of the simulation log
+ * @details push() copies the patterns of a batch into a ring of slots, and
+ * the thread encodes the batches in order. The simulation only waits when
+ * the writer is a whole ring behind.
+ */
+class CirSimLog
+{
+public:
+    typedef std::function<void(const std::vector<size_t> &, const std::vector<size_t> &, int)>
+        Encoder;
+
+    CirSimLog() : _head(0), _tail(0), _stop(false) {}
+    ~CirSimLog()
+    {
+        close();
+    }
+
+    /**
+     * @brief Start the thread
+     * @param[in] slotWords Number of words of a batch, to size the ring
+     */
+    void open(const Encoder &, size_t);
+    /**
+     * @brief Encode the pending batches and stop the thread
+     */
+    void close();
+    /**
+     * @brief Queue the batch (txPatterns, rxPatterns, maskLength)
+     */
+    void push(const std::vector<size_t> &, const std::vector<size_t> &, int);
+
+private:
+    static const size_t RING_BYTES = 1 << 25;
+    static const size_t RING_MAX = 1024;
+
+    struct Slot {
+        std::vector<size_t> tx;
+        std::vector<size_t> rx;
+        int maskLength;
+    };
+
+    CirSimLog(const CirSimLog &);
+    CirSimLog &operator=(const CirSimLog &);
+
+    void run();
+
+    Encoder _encode;
+    std::vector<Slot> _ring;
+    size_t _head;  // Next slot to encode, guarded by _mtx
+    size_t _tail;  // Next slot to fill, guarded by _mtx
+    bool _stop;
+
+    std::mutex _mtx;
+    std::condition_variable _notEmpty;
+    std::condition_variable _notFull;
+    std::thread _thread;
+};
+
+/**
+ * @brief Signals of the simulation, a row of words per gate
+ * @details Each row is padded to whole cache lines of LINE words, and the
+ * buffer starts on a cache line, so no two rows share a line.
+ */
+class CirSimState
+{
+public:
+    static const size_t LINE = 8;  // Words of a cache line
+
+    CirSimState() : _data(0), _stride(0) {}
+    ~CirSimState()
+    {
+        clear();
+    }
+
+    /**
+     * @brief Allocate the rows of at least the given words, uninitialized
+     */
+    void assign(size_t /* rows */, size_t /* words */);
+    void clear();
+
+    size_t *data() const
+    {
+        return _data;
+    }
+    size_t *row(size_t i) const
+    {
+        return _data + i * _stride;
+    }
+    /**
+     * @brief Words from a row to the next, a multiple of LINE
+     */
+    size_t stride() const
+    {
+        return _stride;
+    }
+
+private:
+    CirSimState(const CirSimState &);
+    CirSimState &operator=(const CirSimState &);
+
+    size_t *_data;
+    size_t _stride;
+};
+
+/**
+ * @brief Worker threads of the parallel simulation
+ * @details run(f) calls f(0), ..., f(size() - 1) at once, f(0) on the
+ * calling thread, and returns when all of them are done. The workers sleep
+ * between the calls.
+ */
+class CirSimPool
+{
+public:
+    typedef std::function<void(size_t)> Task;
+
+    CirSimPool() : _task(0), _round(0), _busy(0), _stop(false) {}
+    ~CirSimPool()
+    {
+        close();
+    }
+
+    /**
+     * @brief Start n - 1 workers, if there are not already
+     */
+    void open(size_t /* n */);
+    void close();
+    size_t size() const
+    {
+        return _workers.size() + 1;
+    }
+    void run(const Task &);
+
+private:
+    CirSimPool(const CirSimPool &);
+    CirSimPool &operator=(const CirSimPool &);
+
+    void work(size_t);
+
+    const Task *_task;  // Guarded by _mtx, as the fields below
+    size_t _round;      // Number of calls of run()
+    size_t _busy;       // Workers still running the task
+    bool _stop;
+
+    std::mutex _mtx;
+    std::condition_variable _start;
+    std::condition_variable _done;
+    std::vector<std::thread> _workers;
+};
+
+/**
+ * @brief Instruction of the compiled simulation program
+ * @details state[dst] = (state[a / 2] ^ m(a)) & (state[b / 2] ^ m(b)), where
+ * the XOR mask m(lit) is ~0 for an inverted literal and 0 otherwise. A PO
+ * copies its fanin with a == b.
+ */
+struct CirSimOp {
+    unsigned int dst;  // Gate ID
+    unsigned int a;    // Fanin literals
+    unsigned int b;
+};
+
 class CirMgr
 {
 public:
-    CirMgr() {}
-    ~CirMgr() {}
+    CirMgr()
+        : _simLog(0), _simLogBinary(false), _simLogCount(0), _simWords(SIM_WORDS),
+          _simProgValid(false), _simProgStamp(0), _simLevelStamp(0), _simNativeOn(false),
+          _simThreads(1),
+          _dfsValid(false),
+          _M(0), _I(0), _L(0), _O(0), _A(0), _removed(0),
+          _autoCompact(false)
+    {
+    }
+    ~CirMgr()
+    {
+        reset();
+    }
 
     // Access functions
-    // return '0' if "gid" corresponds to an undefined gate.
-    CirGate *getGate(unsigned gid) const;
+    // return a false view if "gid" corresponds to an undefined gate.
+    CirGate getGate(unsigned gid);
+    /**
+     * @brief Gate by its symbolic name, a false view if no PI / PO has the name
+     */
+    CirGate getGate(const std::string &);
 
     // Member functions about circuit construction
     bool readCircuit(const std::string &);
+    /**
+     * @brief Restore a checkpoint written by saveCircuit()
+     * @param[out] cmdState State of the command flow of the checkpoint
+     */
+    bool loadCircuit(const std::string &, unsigned int &);
 
     // Member functions about circuit optimization
     /**
@@ -50,6 +378,20 @@ public:
      * UNDEF gates may be delete if its fanout becomes empty...
      */
     void optimize();
+    /**
+     * @brief Renumber the live gates densely in topological order
+     * @details The IDs in the file read are kept for the reports, see
+     * CirGate::getOrigId().
+     */
+    void compact();
+    /**
+     * @brief Compact after sweep, optimize, strash and fraig when at least
+     * half of the gate IDs have become empty
+     */
+    void setAutoCompact(bool on)
+    {
+        _autoCompact = on;
+    }
 
     // Member functions about simulation
     /**
@@ -60,11 +402,52 @@ public:
      * @brief Run simulation in preset input patterns to generate FEC groups
      */
     void fileSim(std::ifstream &);
-    void setSimLog(std::ofstream *logFile)
+    /**
+     * @brief Log the simulated patterns to the file, as text or in the binary
+     * pattern format
+     * @details setSimLog(0) completes the previous log.
+     */
+    void setSimLog(std::ofstream *, bool = false);
+    /**
+     * @brief Simulate w words (64 * w patterns) per traversal of the circuit
+     */
+    void setSimWords(unsigned int w)
     {
-        _simLog = logFile;
+        _simWords = w;
     }
 
+    /**
+     * @brief Run the simulation through native code compiled from the
+     * circuit, or the interpreter if no compiler is present
+     */
+    void setSimNative(bool on)
+    {
+        _simNativeOn = on;
+    }
+
+    /**
+     * @brief Share each traversal among n threads
+     * @details A thread simulates whole cache lines of patterns. With fewer
+     * lines of patterns than threads, the threads share the gates of each
+     * logic level instead.
+     */
+    void setSimThreads(unsigned int n)
+    {
+        _simThreads = n;
+    }
+
+    /**
+     * @brief Restart the patterns of randomSim() from the seed
+     */
+    void setSimSeed(unsigned int seed)
+    {
+        rnGen = RandomNumGen(seed);
+    }
+
+    static const unsigned int SIM_WORDS = 16;      // Default words per traversal
+    static const unsigned int SIM_WORDS_MAX = 64;
+    static const unsigned int SIM_THREADS_MAX = 256;
+
     // Member functions about fraig
     void strash();
     void printFEC() const;
@@ -101,23 +484,85 @@ public:
     void printFloatGates() const;
     void printFECPairs() const;
     void writeAag(std::ostream &) const;
-    void writeGate(std::ostream &, CirGate *) const;
+    /**
+     * @brief Write the circuit in binary AIGER format (.aig)
+     * @see CirMgr::writeAag()
+     */
+    void writeAig(std::ostream &) const;
+    /**
+     * @brief Write the fanin cone of the AIG as a standalone, compactly
+     * renumbered AAG
+     */
+    void writeGate(std::ostream &, unsigned int) const;
+    /**
+     * @brief Write a binary checkpoint of the circuit, the FEC groups and the
+     * simulation signatures
+     * @param[in] cmdState State of the command flow, for loadCircuit()
+     */
+    void saveCircuit(std::ostream &, unsigned int) const;
 
     // Get FECGroups
-    const std::vector<std::vector<CirGate *> > &getFECGroups() const;
+    // Each group is a list of literals (2 * gateId + inverted)
+    const std::vector<std::vector<unsigned int> > &getFECGroups() const;
 
     // Member functions about cirMgr
     void reset();
 
 private:
     std::ofstream *_simLog;
+    bool _simLogBinary;
+    size_t _simLogCount;  // Patterns in the binary log
+    CirSimLog _simLogger;
+    unsigned int _simWords;         // Words of patterns per traversal
+    CirSimState _simState;          // _simWords words of signals per gate, by gate ID
+    std::vector<CirSimOp> _simProg;  // Compiled from the DFS list, see simProgram()
+    bool _simProgValid;
+    unsigned int _simProgStamp;  // Changes whenever _simProg is rebuilt
+    std::vector<CirSimOp> _simLevelProg;  // _simProg by logic level, see simLevelProgram()
+    std::vector<size_t> _simLevelBeg;     // First operation of each level
+    unsigned int _simLevelStamp;          // _simProgStamp of _simLevelProg
+    CirSimNative _simNative;     // Native code of _simProg
+    bool _simNativeOn;
+    static const size_t SIM_LINE = CirSimState::LINE;
+    static const size_t SIM_L2 = 1 << 18;  // Bytes of L2 cache per thread
+    unsigned int _simThreads;
+    CirSimPool _simPool;  // _simThreads threads during a simulation
 
     // DFSList Maintainer or builder
-    void DepthFirstTraversal(const unsigned int, std::vector<CirGate *> &) const;
-    void DepthFirstTraversal(CirGate *, std::vector<CirGate *> &) const;
+    void DepthFirstTraversal(const unsigned int, std::vector<unsigned int> &) const;
+    /**
+     * @brief Cached DFS list of the PO cones, fanins first
+     */
+    const std::vector<unsigned int> &dfsList() const;
+    /**
+     * @brief Drop the cached DFS list, it is rebuilt by the next dfsList()
+     */
+    void invalidateDfsList();
+    /**
+     * @brief Drop the cached DFS list if the merged or removed gate is in it
+     */
+    void invalidateDfsList(unsigned int);
 
     // Loader Function
-    bool readHeader(const std::string &);
+    bool readHeader();
+    /**
+     * @brief Load the body of an ASCII AIGER (.aag) file
+     * @details Single pass over the file buffer; fanins are connected after
+     * the whole body has been accepted.
+     */
+    bool readAscii();
+    /**
+     * @brief Load the AIG lines of an ASCII file, in parallel if it is huge
+     * @param[out] rhs The 2 fanin literals of each AIG
+     */
+    bool readAigSection(unsigned int *);
+    /**
+     * @brief Load the body of a binary AIGER (.aig) file
+     * @details Called after the "aig" header, AIGs are decoded from their
+     * delta codes and connected in a single pass.
+     */
+    bool readBinary();
+    bool readSymbol();
     bool loadInput(const unsigned int &);
     /**
      * @brief Output pin will have no fanout, but 1 fanin
@@ -133,10 +578,15 @@ private:
      */
     bool loadAIG(const unsigned int &);
     /**
-     * @brief Load the latches
-     * @note Not supported yet.
+     * @brief Connect the gate to the fanin literal
+     * @details The fanin is created as an UNDEF gate if it is not defined.
      */
-    bool loadLatch(const unsigned int &, const unsigned int &);
+    void connectLit(unsigned int, const unsigned int &);
+    /**
+     * @brief Define the gate in the store
+     * @param[in] lineNo Line of the definition, 0 for CONST and UNDEF gates
+     */
+    void newGate(GateType, const unsigned int &, const unsigned int &);
     bool loadSymbol(const unsigned int &, const std::string &);
     bool loadComment(const std::string &);
 
@@ -145,40 +595,48 @@ private:
     void getNotUsedList(std::vector<unsigned int> & /* notused */);
 
     // Gate Property Modifier
-    void connect(CirGate *, CirGate *);
-    void sortInOut();
     void sortIn();
-    void sortOut();
 
     // Gate Property Modifier (Defined outside cirMgr.cpp)
     bool removeGate(const unsigned int &);
-    bool removeGate(CirGate *);
-    bool removePIGate(CirGate *);
-    bool removePOGate(CirGate *);
-    bool removeAIGate(CirGate *);
-    bool removeUndefGate(CirGate *);
-    void replaceConnection(CirGate *, CirGate *, CirGate *);
-    void mergeGate(CirGate *, CirGate *);
+    bool removePIGate(unsigned int);
+    bool removePOGate(unsigned int);
+    bool removeAIGate(unsigned int);
+    bool removeUndefGate(unsigned int);
+    /**
+     * @brief Move the fanouts of the gate to the literal, then remove it
+     * @param[in] to 2 * (ID of the remaining gate) + inverted
+     */
+    void mergeGate(unsigned int, unsigned int);
+    /**
+     * @brief Drop the IDs of the removed gates from _aig, _notused and
+     * _floating, which keep them until the end of a pass
+     */
+    void compactLists();
+    /**
+     * @brief compact() if auto compaction is on and the gates are sparse
+     */
+    void autoCompact();
 
     // Gate Property Identifier (Defined outside cirMgr.cpp)
     /**
-     * @details identityFanin() is consider as true when only c is type
-     * CirAIGate. The parameter phase is set as true if the fanin is inverter
+     * @details identityFanin() is consider as true when only c is an AIG
+     * gate. The parameter phase is set as true if the fanin is inverter
      * identical.
      */
-    bool identityFanin(CirGate *, bool & /* phase */) const;
+    bool identityFanin(unsigned int, bool & /* phase */) const;
     /**
-     * @details HasConstFanin() is consider as true when only c is type
-     * CirAIGate or CirPOGate.
-     * @param[in]  c   pointer to AI Gate or PO Gate
+     * @details HasConstFanin() is consider as true when only c is an AIG
+     * gate or a PO gate.
+     * @param[in]  c   ID of AI Gate or PO Gate
      * @param[out] num Index of the CONST fanin
      */
-    bool hasConstFanin(CirGate *, int & /* index */) const;
+    bool hasConstFanin(unsigned int, int & /* index */) const;
     /**
      * @brief Check AI gates a and b are identical
-     * @param[in] a, b CirAIGate a, b
+     * @param[in] a, b AIG gates a, b
      */
-    bool identityStruct(CirGate *, CirGate *) const;
+    bool identityStruct(unsigned int, unsigned int) const;
 
     // FRAIG Function
     void createCNF(SatSolver & /* solver */);
@@ -187,30 +645,108 @@ private:
     void encodePattern(const std::vector<size_t> & /* txPatterns */,
                        const std::vector<size_t> & /* rxPatterns */, int /* maskLength */,
                        std::ostream * /* os */) const;
-    int parsePattern(std::vector<std::vector<size_t> > & /* patternsGroups */,
-                     std::istream & /* is */) const;
+    /**
+     * @brief Parse the next (up to) 64 patterns of the file
+     * @param[out] txPatterns The patterns array for all input, transposed
+     * @param[in]  again      Patterns of the file have been simulated before
+     * @return int Number of patterns, 0 at the end of the file or on a line
+     * of the wrong length, -1 on a non-0/1 character, which rejects the file
+     */
+    int parsePattern(std::vector<size_t> & /* txPatterns */, CirPatternBuf & /* buf */,
+                     bool /* again */) const;
+    /**
+     * @brief Fill the batch with random patterns
+     * @return int Number of patterns, 64 * _simWords
+     */
     int genPattern(std::vector<size_t> & /* txPatterns */) const;
+    /**
+     * @brief Write the header of the binary pattern format
+     * @param[in] count Number of patterns in the file
+     */
+    void encodePatternHeader(size_t /* count */, std::ostream * /* os */) const;
+    /**
+     * @brief Write a block of (up to) 64 patterns in the binary pattern format
+     */
+    void encodePatternBlock(const std::vector<size_t> & /* txPatterns */,
+                            const std::vector<size_t> & /* rxPatterns */, int /* maskLength */,
+                            std::ostream * /* os */) const;
+    /**
+     * @brief Check the header of the binary pattern format
+     * @param[out] count Number of patterns in the file
+     * @param[out] nPO   Number of output words in each block
+     */
+    bool parsePatternHeader(CirPatternBuf & /* buf */, size_t & /* count */,
+                            unsigned int & /* nPO */) const;
+    /**
+     * @brief Parse the next block of (up to) 64 patterns of the binary format
+     * @param[in,out] left Number of patterns left in the file
+     * @return int Number of patterns, 0 at the end of the file or on error
+     */
+    int parsePatternBlock(std::vector<size_t> & /* txPatterns */, CirPatternBuf & /* buf */,
+                          size_t & /* left */, unsigned int /* nPO */) const;
 
     // Simulation Function
-    void splitFECGroups(int /* maskLength */, bool /* again */);
+    // A batch has up to 64 * _simWords patterns; the patterns of word w of
+    // the batch are in txPatterns[w * _I, (w + 1) * _I), as parsePattern()
+    // gives them, and only the last word may be partial.
+    /**
+     * @param[in] count Number of patterns of the batch
+     */
+    void splitFECGroups(size_t /* count */, bool /* again */);
     void initFECGroups();
-    void simulateOnce(const std::vector<size_t> & /* txPatterns */, int /* maskLength */,
+    /**
+     * @brief Set up _simState, the signals of the gates start from the
+     * last simulation
+     */
+    void initSimState();
+    /**
+     * @brief Keep the signals of the last word in the store, release
+     * _simState
+     */
+    void finishSimState();
+    void simulateOnce(const std::vector<size_t> & /* txPatterns */, size_t /* count */,
                       bool /* again */);
-    void feedSignal(const std::vector<size_t> & /* txPatterns */);
-    void getSignal(std::vector<size_t> & /* rxPatterns */);
+    /**
+     * @brief The AIGs and POs of the DFS list as a flat program, fanins
+     * first
+     * @details Cached with the DFS list, see invalidateDfsList()
+     */
+    const std::vector<CirSimOp> &simProgram();
+    /**
+     * @brief simProgram() in order of logic level, the operations of level l
+     * are [_simLevelBeg[l], _simLevelBeg[l + 1])
+     */
+    const std::vector<CirSimOp> &simLevelProgram();
+    void simulateLevels(size_t /* nWord */);
+    void feedSignal(const std::vector<size_t> & /* txPatterns */, size_t /* nWord */);
+    void getSignal(std::vector<size_t> & /* rxPatterns */, size_t /* nWord */);
+
+    // Writer Helper
+    void writeSymbol(CirWriteBuf &) const;
+
+    /**
+     * @brief View of the gate in _store
+     */
+    CirGate view(unsigned int id) const
+    {
+        return CirGate(const_cast<CirStore *>(&_store), id);
+    }
 
     // Message Printer
-    void SimplifyMsg(CirGate *, CirGate *) const;
-    void StrashMsg(CirGate *, CirGate *) const;
-    void FraigMsg(CirGate *, CirGate *) const;
+    void SimplifyMsg(unsigned int, const unsigned int &) const;
+    void StrashMsg(unsigned int, const unsigned int &) const;
+    void FraigMsg(unsigned int, const unsigned int &) const;
 
     std::vector<unsigned int> _pin;       // PinIn Number
     std::vector<unsigned int> _pout;      // PinOut Number
     std::vector<unsigned int> _aig;       // AIGs Number
-    std::vector<unsigned int> _latch;     // Latch Number
     std::vector<unsigned int> _floating;  // Floating Gates
     std::vector<unsigned int> _notused;   // Not in used Gates
-    std::vector<CirGate *> _gates;
+    CirStore _store;  // The gates, by gate ID
+
+    mutable std::vector<unsigned int> _dfsList;  // DFS list of the PO cones
+    mutable std::vector<unsigned int> _dfsPos;   // Index in _dfsList, NO_LIT if absent
+    mutable bool _dfsValid;  // _dfsList is the one of a fresh DFS
 
     std::stringstream _comment;  // Store the comment
 
@@ -219,8 +755,10 @@ private:
     unsigned int _L;  // Number of Latches
     unsigned int _O;  // Number of Outputs
     unsigned int _A;  // Number of AND Gates
+    unsigned int _removed;  // Removed gates not compacted from the lists yet
+    bool _autoCompact;      // Compact after large reductions
 
-    std::vector<std::vector<CirGate *> > FECs;  // Functionally Equivalent Candidate (FEC) Groups
+    std::vector<std::vector<unsigned int> > FECs;  // Functionally Equivalent Candidate (FEC) Groups
     RandomNumGen rnGen;                         // Random Number Generator
 };
 
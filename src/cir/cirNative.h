@@ -0,0 +1,80 @@
+/****************************************************************************
+  FileName     [ cirNative.h ]
+  PackageName  [ cir ]
+  Synopsis     [ Define native code generation of the simulation program ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2008-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+
+#ifndef CIR_NATIVE_H
+#define CIR_NATIVE_H
+
+#include <stddef.h>
+
+#include <ostream>
+#include <vector>
+
+struct CirSimOp;
+
+/**
+ * @brief Simulation program compiled to machine code
+ * @details The program is emitted as straight-line C++, one statement per
+ * gate on GCC vector types of the row width, compiled by the local compiler
+ * ($CXX, or c++) for the host CPU into a shared object and loaded with
+ * dlopen(). Compiling takes far longer than one traversal, so it only pays
+ * off for large pattern sets.
+ */
+class CirSimNative
+{
+public:
+    CirSimNative() : _lib(0), _func(0), _stamp(0), _words(0), _vector(1) {}
+    ~CirSimNative()
+    {
+        close();
+    }
+
+    /**
+     * @brief Compile and load the program for rows of the given words
+     * @param[in] stamp Identifies the program, see ready()
+     * @return false if there is no working compiler
+     */
+    bool build(const std::vector<CirSimOp> &, size_t /* words */, unsigned int /* stamp */);
+    /**
+     * @brief True if the loaded code is the one of build(prog, words, stamp)
+     */
+    bool ready(unsigned int stamp, size_t words) const
+    {
+        return _func && _stamp == stamp && _words == words;
+    }
+    /**
+     * @brief Simulate words [w0, w1) of the rows of the signals, words per
+     * gate
+     * @details The state starts on a cache line, as CirSimState does. w0
+     * and w1 are multiples of 8, or w1 is the row width.
+     */
+    void run(size_t *state, size_t w0, size_t w1) const
+    {
+        _func(state, w0 / _vector, w1 / _vector);
+    }
+    void close();
+
+private:
+    typedef void (*Func)(size_t *, size_t, size_t);
+
+    static const size_t CHUNK = 1 << 7;  // Statements per emitted function
+    static const char *const CXXFLAGS[];  // Options after $CXX, 0-terminated
+
+    CirSimNative(const CirSimNative &);
+    CirSimNative &operator=(const CirSimNative &);
+
+    static size_t vectorWords(size_t);
+    static void emit(std::ostream &, const std::vector<CirSimOp> &, size_t);
+
+    void *_lib;  // dlopen() handle
+    Func _func;
+    unsigned int _stamp;
+    size_t _words;
+    size_t _vector;  // Words of the emitted vector type
+};
+
+#endif  // CIR_NATIVE_H
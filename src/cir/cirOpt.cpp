@@ -30,25 +30,23 @@ using namespace std;
 void CirMgr::sweep()
 {
     // TODO
-    stack<CirGate *> frontier;
-    CirGate *target = 0;
-    CirGate *inGate = 0;
-    size_t i = 0;
-    bool invert = false;
+    vector<unsigned int> left(_store.type.size(), NO_LIT);  // Fanouts not swept yet
+    CirGate target, inGate;
 
     // Iterately remove and update _notused
     for (size_t i = 0; i < _notused.size(); ++i) {
-        target = _gates[_notused[i]];
+        target = view(_notused[i]);
 
-        for (size_t j = 0; j < target->_fanin.size(); ++j) {
-            inGate = gate(target->_fanin[j]);
-            invert = isInv(target->_fanin[j]);
+        for (size_t j = 0; j < target.faninSize(); ++j) {
+            inGate = view(target.fanin(j) / 2);
 
-            target->disconnectFanin(target->_fanin[j]);
+            if (left[inGate._gateId] == NO_LIT) {
+                left[inGate._gateId] = inGate.fanout().size();
+            }
 
             // If inGate has no fanout, Mark as NOTUSED GATE
-            if (!inGate->_fanout.size() && !dynamic_cast<CirConstGate *>(inGate)) {
-                _notused.push_back(inGate->_gateId);
+            if (!--left[inGate._gateId] && !inGate.isConst()) {
+                _notused.push_back(inGate._gateId);
             }
         }
     }
@@ -56,186 +54,297 @@ void CirMgr::sweep()
     // Maintain CirMgr Message.
     sort(_notused.begin(), _notused.end());
 
-    i = 0;
-    while (i < _notused.size()) {
-        target = _gates[_notused[i]];
+    for (size_t i = 0; i < _notused.size(); ++i) {
+        target = view(_notused[i]);
 
-        if (target->isAig() || target->isFloating()) {
-            cout << "Sweeping: " << target->getTypeStr() << '(' << target->_gateId << ") removed..."
+        if (target.isAig() || target.isFloating()) {
+            cout << "Sweeping: " << target.getTypeStr() << '(' << target._gateId << ") removed..."
                  << endl;
-            removeGate(target);
-            _notused.erase(_notused.begin() + i);
-        } else {
-            ++i;
+            removeGate(target._gateId);
         }
     }
 
-    i = 0;
-    while (i < _floating.size()) {
-        if (!_gates[_floating[i]]) {
-            _floating.erase(_floating.begin() + i);
-        } else {
-            ++i;
-        }
-    }
+    // Drop the removed gates from _aig, _notused and _floating
+    compactLists();
+    autoCompact();
 }
 
 void CirMgr::optimize()
 {
     // TODO
 
-    vector<CirGate *> dfslist;
-    CirGate *target;
+    vector<unsigned int> dfslist = dfsList();  // Merging drops the cached list
+    unsigned int target;
+    const unsigned int *in;
     int num;
     bool phase;
 
-    // Build up DFS List
-    CirGate::raiseGlobalMarker();
-    for (size_t o = 0; o < _O; ++o) {
-        DepthFirstTraversal(_M + o + 1, dfslist);
-    }
-
     // Iterate DFS List, and check if CASE 1~4 satisfy
     for (size_t i = 0; i < dfslist.size(); ++i) {
         target = dfslist[i];
-
-        if (hasConstFanin(target, num) && target->isAig()) {
-            if (!isInv(target->_fanin[num])) {  // Case 1: CONST 0 in
-                                                // CirAIGate->_fanin[num]
-                SimplifyMsg(target, target->_fanin[num]);
-                mergeGate(target, target->_fanin[num]);
-            } else if (isInv(target->_fanin[num])) {  // Case 2: CONST 1 in
-                                                      // CirAIGate->_fanin[num]
-                SimplifyMsg(target, target->_fanin[1 - num]);
-                mergeGate(target, target->_fanin[1 - num]);
+        in = &_store.fanin[2 * target];
+
+        if (hasConstFanin(target, num) && _store.type[target] == AIG_GATE) {
+            if (!isInv(in[num])) {  // Case 1: CONST 0 in in[num]
+                SimplifyMsg(target, in[num]);
+                mergeGate(target, in[num]);
+            } else if (isInv(in[num])) {  // Case 2: CONST 1 in in[num]
+                SimplifyMsg(target, in[1 - num]);
+                mergeGate(target, in[1 - num]);
             }
         } else if (identityFanin(target, phase)) {
             if (phase) {  // Case 3: Invert Fanin
-                SimplifyMsg(target, _gates[0]);
-                mergeGate(target, _gates[0]);
+                SimplifyMsg(target, 0);
+                mergeGate(target, 0);
             } else {  // Case 4: Identical Fanin
-                SimplifyMsg(target, target->_fanin[0]);
-                mergeGate(target, target->_fanin[0]);
+                SimplifyMsg(target, in[0]);
+                mergeGate(target, in[0]);
             }
         }
     }
 
     // Maintain cirMgr Property
+    compactLists();
     _notused.clear();
     getNotUsedList(_notused);
     _floating.clear();
     getFloatingList(_floating);
+    autoCompact();
+}
+
+/*
+   New IDs: CONST 0, the PIs in order, the UNDEF gates, the AIGs in a
+   topological order of all AIGs, then the POs in order. The simulation
+   signatures and the FEC groups are kept.
+*/
+void CirMgr::compact()
+{
+    vector<unsigned int> newId(_store.type.size(), NO_LIT);
+    vector<unsigned int> order;
+    CirStore store;
+    unsigned int n = 1, m, lit;
+    size_t id;
+
+    compactLists();
+
+    newId[0] = 0;
+    for (size_t i = 0; i < _pin.size(); ++i) {
+        newId[_pin[i]] = n++;
+    }
+    for (size_t i = 1; i <= _M; ++i) {
+        if (_store.type[i] == UNDEF_GATE) {
+            newId[i] = n++;
+        }
+    }
+    CirGate::raiseGlobalMarker();
+    for (size_t a = 0; a < _aig.size(); ++a) {
+        DepthFirstTraversal(_aig[a], order);
+    }
+    for (size_t i = 0; i < order.size(); ++i) {
+        if (_store.type[order[i]] == AIG_GATE) {
+            newId[order[i]] = n++;
+        }
+    }
+    m = n - 1;
+    for (size_t i = 0; i < _pout.size(); ++i) {
+        newId[_pout[i]] = n++;
+    }
+
+    cout << "Compacting: " << _store.type.size() << " gate IDs into " << n << "..." << endl;
+
+    // Move the gate data to the new IDs
+    store.assign(n);
+    store.origId.resize(n);
+    for (size_t i = 0; i < _store.type.size(); ++i) {
+        if (!_store.has(i)) {
+            continue;
+        }
+        id = newId[i];
+        assert(id != NO_LIT);
+
+        store.type[id] = _store.type[i];
+        store.lineNo[id] = _store.lineNo[i];
+        for (size_t k = 0; k < 2; ++k) {
+            lit = _store.fanin[2 * i + k];
+            store.fanin[2 * id + k] = (lit == NO_LIT) ? NO_LIT : 2 * newId[lit / 2] + isInv(lit);
+        }
+        if (_store.symbol.has(i)) {
+            store.symbol.insert(id, _store.symbol.get(i));
+        }
+        store.origId[id] = view(i).getOrigId();
+        store.state[id] = _store.state[i];
+        store.marker[id] = _store.marker[i];
+        store.var[id] = _store.var[i];
+    }
+    _store = std::move(store);
+    invalidateDfsList();
+
+    // Maintain Mgr Attribute
+    {
+        vector<unsigned int> *lists[5] = {&_pin, &_pout, &_aig, &_floating, &_notused};
+
+        for (size_t k = 0; k < 5; ++k) {
+            for (size_t i = 0; i < lists[k]->size(); ++i) {
+                (*lists[k])[i] = newId[(*lists[k])[i]];
+            }
+        }
+    }
+    sort(_aig.begin(), _aig.end());
+    sort(_floating.begin(), _floating.end());
+    sort(_notused.begin(), _notused.end());
+    for (size_t i = 0; i < FECs.size(); ++i) {
+        for (size_t j = 0; j < FECs[i].size(); ++j) {
+            FECs[i][j] = 2 * newId[FECs[i][j] / 2] + isInv(FECs[i][j]);
+        }
+    }
+    _M = m;
 }
 
+
 /***************************************************/
 /*   Private member functions about optimization   */
 /***************************************************/
 
-bool CirMgr::removeGate(const unsigned int &id)
-{
-    return removeGate(_gates[id]);
-}
-
 /**
  * @brief Remove a gate
  * @note Actually Only AIGate and UndefGate will be removed
  */
-bool CirMgr::removeGate(CirGate *gate)
+bool CirMgr::removeGate(const unsigned int &id)
 {
-    if (dynamic_cast<CirAIGate *>(gate)) {
-        return removeAIGate(gate);
-    }
-
-    if (dynamic_cast<CirUndefGate *>(gate)) {
-        return removeUndefGate(gate);
-    }
-
-    if (dynamic_cast<CirPIGate *>(gate)) {
-        return removePIGate(gate);
+    switch (_store.type[id]) {
+        case AIG_GATE:
+            return removeAIGate(id);
+        case UNDEF_GATE:
+            return removeUndefGate(id);
+        case PI_GATE:
+            return removePIGate(id);
+        case PO_GATE:
+            return removePOGate(id);
+        default:
+            return false;
     }
-
-    if (dynamic_cast<CirPOGate *>(gate)) {
-        return removePOGate(gate);
-    }
-
-    return false;
 }
 
-bool CirMgr::removePIGate(CirGate *gate)
+bool CirMgr::removePIGate(unsigned int id)
 {
     return false;
 }
 
-bool CirMgr::removePOGate(CirGate *gate)
+bool CirMgr::removePOGate(unsigned int id)
 {
     return false;
 }
 
-bool CirMgr::removeAIGate(CirGate *gate)
+bool CirMgr::removeAIGate(unsigned int id)
 {
-    unsigned int id = gate->_gateId;
+    invalidateDfsList(id);
 
-    // Release the Memory
-    delete _gates[id];
-    _gates[id] = 0;
+    // Release the slot
+    _store.erase(id);
 
-    // Maintain Mgr Attribute
-    _aig.erase(find(_aig.begin(), _aig.end(), id));
+    // Maintain Mgr Attribute, the ID stays in _aig until compactLists()
+    ++_removed;
     --_A;
 
     return true;
 }
 
-bool CirMgr::removeUndefGate(CirGate *gate)
+bool CirMgr::removeUndefGate(unsigned int id)
 {
-    unsigned int id = gate->_gateId;
+    invalidateDfsList(id);
 
-    // Release the Memory
-    delete _gates[id];
-    _gates[id] = 0;
+    // Release the slot
+    _store.erase(id);
 
-    // Maintain Mgr Attribute
-    /* Nothing */
+    // Maintain Mgr Attribute, the ID stays in _floating until compactLists()
+    ++_removed;
 
     return true;
 }
 
 /*
-   @param from, to
-      The gate to be merged or ready to merge.
+   Sweep, optimize, strash and fraig leave the IDs of the removed gates
+   empty. Once at least half of them are, the arrays are mostly holes.
+*/
+void CirMgr::autoCompact()
+{
+    size_t live = 0;
+
+    if (!_autoCompact) {
+        return;
+    }
+    for (size_t i = 0; i < _store.type.size(); ++i) {
+        live += _store.has(i);
+    }
+    if (2 * live <= _store.type.size()) {
+        compact();
+    }
+}
+
+/*
+   Remove the IDs of the removed gates from the gate lists, in one pass
+   over each list.
 */
-void CirMgr::mergeGate(CirGate *from, CirGate *to)
+void CirMgr::compactLists()
 {
-    vector<CirGate *>::iterator it;
-    bool setInvert;
+    vector<unsigned int> *lists[3] = {&_aig, &_notused, &_floating};
+    vector<unsigned int> *list;
+    size_t n;
 
-    for (size_t i = 0; i < from->_fanout.size(); ++i) {
-        setInvert = isInv(to) ^ isInv(from->_fanout[i]);
+    if (!_removed) {
+        return;
+    }
 
-        // Copy the link to merge gate.
-        gate(to)->addFanout(gate(from->_fanout[i]), setInvert);
+    for (size_t k = 0; k < 3; ++k) {
+        list = lists[k];
+        n = 0;
+        for (size_t i = 0; i < list->size(); ++i) {
+            if (_store.has((*list)[i])) {
+                (*list)[n++] = (*list)[i];
+            }
+        }
+        list->resize(n);
+    }
+    _removed = 0;
+}
 
-        // Update the link for FanOuts
-        *find(gate(from->_fanout[i])->_fanin.begin(), gate(from->_fanout[i])->_fanin.end(),
-              isInv(from->_fanout[i]) ? setInv(from) : from) = (setInvert) ? setInv(to) : gate(to);
+/*
+   @param from
+      The gate to be merged.
+   @param to
+      The literal ready to merge, taken by value as it may be a fanin of from.
+*/
+void CirMgr::mergeGate(unsigned int from, unsigned int to)
+{
+    vector<unsigned int> slots;
+    unsigned int *in;
+
+    invalidateDfsList(from);
+    _store.getFanoutSlot(from, slots);
+
+    for (size_t i = 0; i < slots.size(); ++i) {
+        // Update the link of the fanout in place, by its fanin slot
+        in = &_store.fanin[slots[i]];
+        *in = to ^ isInv(*in);
+
+        // Copy the link to merge gate.
+        _store.addFanout(to / 2, slots[i]);
     }
 
-    // from->_fanout.clear();
-    from->disconnectFanin(NULL);
     removeGate(from);
     return;
 }
 
-void CirMgr::SimplifyMsg(CirGate *from, CirGate *to) const
+void CirMgr::SimplifyMsg(unsigned int from, const unsigned int &to) const
 {
-    cout << "Simplifying: " << gate(to)->_gateId << " merging " << ((isInv(to)) ? "!" : "")
-         << from->_gateId << "..." << endl;
+    cout << "Simplifying: " << to / 2 << " merging " << ((isInv(to)) ? "!" : "") << from << "..."
+         << endl;
 }
 
-bool CirMgr::hasConstFanin(CirGate *c, int &num) const
+bool CirMgr::hasConstFanin(unsigned int c, int &num) const
 {
-    for (size_t i = 0; i < c->_fanin.size(); ++i) {
-        if (gate(c->_fanin[i])->isConst()) {
+    for (size_t i = 0; i < _store.faninSize(c); ++i) {
+        if (_store.fanin[2 * c + i] / 2 == 0) {
             num = i;
             return true;
         }
@@ -244,13 +353,13 @@ bool CirMgr::hasConstFanin(CirGate *c, int &num) const
     return false;
 }
 
-bool CirMgr::identityFanin(CirGate *c, bool &phase) const
+bool CirMgr::identityFanin(unsigned int c, bool &phase) const
 {
-    if (c->_fanin.size() != 2) {
+    if (_store.faninSize(c) != 2) {
         return 0;
     }
 
-    size_t i = ((size_t)(c->_fanin[0]) ^ (size_t)(c->_fanin[1]));
+    size_t i = _store.fanin[2 * c] ^ _store.fanin[2 * c + 1];
 
     if (i < 2) {
         phase = (bool)i;
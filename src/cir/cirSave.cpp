@@ -0,0 +1,437 @@
+/****************************************************************************
+  FileName     [ cirSave.cpp ]
+  PackageName  [ cir ]
+  Synopsis     [ Define binary checkpoint of the circuit manager ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2008-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+
+#include <stdint.h>
+
+#include <cstring>
+#include <iostream>
+
+#include "cirGate.h"
+#include "cirMgr.h"
+
+using namespace std;
+
+/*
+   Checkpoint layout (native byte order, every array 8-byte aligned):
+
+      CirCkptHeader
+      uint8_t  type[n]                 CirCkptType of each slot of _store
+      uint32_t lineNo[n]
+      uint64_t state[n]                Simulation signature
+      uint64_t faninBeg[n + 1],  uint32_t faninLit[]
+      uint64_t symbolBeg[n + 1], char symbol[]
+      uint32_t pin[], pout[], aig[], floating[], notused[]
+      uint32_t origId[]                ID in the file read, empty if not renumbered
+      uint64_t fecBeg[#group + 1], uint32_t fecLit[]
+      char     comment[]
+
+   where n = M + O + 1 slots, a literal is 2 * gateId + inverted, and each
+   array is preceded by its length in a uint64_t. The arrays are used in
+   place from the mapped file. Fanouts are not saved, they are rebuilt from
+   the fanins on demand.
+
+   Bump CIR_CKPT_VERSION whenever the layout of a released version changes.
+*/
+static const char CIR_CKPT_MAGIC[8] = {'C', 'I', 'R', 'C', 'K', 'P', 'T', '\0'};
+static const uint32_t CIR_CKPT_VERSION = 1;
+static const uint32_t CIR_CKPT_BYTE_ORDER = 0x01020304;
+
+enum CirCkptType {
+    CKPT_NONE,
+    CKPT_CONST,
+    CKPT_PI,
+    CKPT_PO,
+    CKPT_AIG,
+    CKPT_UNDEF
+};
+
+// Checkpoint type of each GateType
+static const uint8_t CIR_CKPT_TYPE[NO_GATE + 1] = {CKPT_UNDEF, CKPT_PI,    CKPT_PO,
+                                                   CKPT_AIG,   CKPT_CONST, CKPT_NONE};
+
+struct CirCkptHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t cmdState;
+    uint32_t M, I, L, O, A;
+    uint32_t reserved;
+    uint64_t nGates;
+};
+
+/**************************************/
+/*   Static varaibles and functions   */
+/**************************************/
+
+static void putPad(CirWriteBuf &out, size_t n)
+{
+    static const char zeros[8] = {0};
+
+    out.write(zeros, (8 - n % 8) % 8);
+}
+
+template <class T>
+static void putArray(CirWriteBuf &out, const T *data, uint64_t n)
+{
+    out.write(&n, sizeof(n));
+    out.write(data, n * sizeof(T));
+    putPad(out, n * sizeof(T));
+}
+
+template <class T>
+static void putArray(CirWriteBuf &out, const vector<T> &v)
+{
+    putArray(out, v.data(), v.size());
+}
+
+// Number of fanins a gate of the type must have
+static uint64_t faninSize(uint8_t type)
+{
+    return (type == CKPT_PO) ? 1 : (type == CKPT_AIG) ? 2 : 0;
+}
+
+// beg[0..n] are non-decreasing offsets from 0 to total
+static bool isOffsets(const uint64_t *beg, uint64_t n, uint64_t total)
+{
+    if (!beg || beg[0] || beg[n] != total) {
+        return false;
+    }
+    for (uint64_t i = 0; i < n; ++i) {
+        if (beg[i] > beg[i + 1]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+   Cursor on the mapped checkpoint. Any read beyond the end marks it as bad.
+*/
+class CirCkptReader
+{
+public:
+    CirCkptReader(const char *b, const char *e) : _p(b), _end(e), _good(true) {}
+
+    bool good() const
+    {
+        return _good;
+    }
+
+    template <class T>
+    const T *getArray(uint64_t &n)
+    {
+        const T *data;
+        uint64_t bytes;
+
+        n = 0;
+        if (!_good || (size_t)(_end - _p) < sizeof(n)) {
+            return fail<T>();
+        }
+        memcpy(&n, _p, sizeof(n));
+        _p += sizeof(n);
+
+        if (n > (uint64_t)(_end - _p) / sizeof(T)) {
+            return fail<T>();
+        }
+        bytes = n * sizeof(T);
+        data = (const T *)_p;
+        _p += bytes;
+        _p += std::min((size_t)((8 - bytes % 8) % 8), (size_t)(_end - _p));
+
+        return data;
+    }
+
+    // Array of exactly n elements
+    template <class T>
+    const T *getArray(uint64_t n, int)
+    {
+        uint64_t m;
+        const T *data = getArray<T>(m);
+
+        return (m == n) ? data : fail<T>();
+    }
+
+private:
+    template <class T>
+    const T *fail()
+    {
+        _good = false;
+        return 0;
+    }
+
+    const char *_p;
+    const char *_end;
+    bool _good;
+};
+
+/**************************************************************/
+/*   class CirMgr member functions for checkpoint             */
+/**************************************************************/
+
+/*
+   Serialize the circuit, the FEC groups and the simulation signatures.
+
+   @param cmdState
+      State of the command flow, returned by loadCircuit()
+*/
+void CirMgr::saveCircuit(ostream &outfile, unsigned int cmdState) const
+{
+    CirWriteBuf out(outfile);
+    CirCkptHeader header;
+    size_t n = _store.type.size();
+    vector<uint8_t> types(n, CKPT_NONE);
+    vector<uint32_t> lineNo(n, 0), lits;
+    vector<uint64_t> state(n, 0), beg(1, 0);
+    string symbols;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CIR_CKPT_MAGIC, sizeof(header.magic));
+    header.version = CIR_CKPT_VERSION;
+    header.byteOrder = CIR_CKPT_BYTE_ORDER;
+    header.cmdState = cmdState;
+    header.M = _M;
+    header.I = _I;
+    header.L = _L;
+    header.O = _O;
+    header.A = _A;
+    header.nGates = n;
+    out.write(&header, sizeof(header));
+
+    for (size_t i = 0; i < n; ++i) {
+        if (!_store.has(i)) {
+            continue;
+        }
+
+        types[i] = CIR_CKPT_TYPE[_store.type[i]];
+        lineNo[i] = _store.lineNo[i];
+        state[i] = _store.state[i];
+    }
+    putArray(out, types);
+    putArray(out, lineNo);
+    putArray(out, state);
+
+    // Fanin
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < _store.faninSize(i); ++j) {
+            lits.push_back(_store.fanin[2 * i + j]);
+        }
+        beg.push_back(lits.size());
+    }
+    putArray(out, beg);
+    putArray(out, lits);
+
+    // Symbol
+    beg.assign(1, 0);
+    for (size_t i = 0; i < n; ++i) {
+        symbols += _store.symbol.get(i);
+        beg.push_back(symbols.size());
+    }
+    putArray(out, beg);
+    putArray(out, symbols.data(), symbols.size());
+
+    putArray(out, _pin);
+    putArray(out, _pout);
+    putArray(out, _aig);
+    putArray(out, _floating);
+    putArray(out, _notused);
+    putArray(out, _store.origId);
+
+    // FEC groups
+    beg.assign(1, 0);
+    lits.clear();
+    for (size_t i = 0; i < FECs.size(); ++i) {
+        lits.insert(lits.end(), FECs[i].begin(), FECs[i].end());
+        beg.push_back(lits.size());
+    }
+    putArray(out, beg);
+    putArray(out, lits);
+
+    // Comment
+    putArray(out, _comment.str().data(), _comment.str().size());
+}
+
+/*
+   Restore the state saved by saveCircuit() from a mapped checkpoint file.
+
+   @param cmdState
+      State of the command flow when the checkpoint was saved
+*/
+bool CirMgr::loadCircuit(const string &fileName, unsigned int &cmdState)
+{
+    CirReadBuf file;
+    CirCkptHeader header;
+    const uint8_t *types;
+    const uint32_t *lineNo, *faninLit, *fecLit, *list;
+    const uint64_t *state, *faninBeg, *symbolBeg, *fecBeg;
+    const char *symbols, *comment;
+    uint64_t n, nLit = 0, nGroup = 0, nChar = 0;
+
+    if (!file.open(fileName)) {
+        cerr << "Cannot open checkpoint \"" << fileName << "\"!!" << endl;
+        return false;
+    }
+    if (!file.readAll()) {
+        cerr << "Error: checkpoint \"" << fileName << "\" is corrupted!!" << endl;
+        return false;
+    }
+
+    if ((size_t)(file.end() - file.begin()) < sizeof(header) ||
+        memcmp(file.begin(), CIR_CKPT_MAGIC, sizeof(CIR_CKPT_MAGIC))) {
+        cerr << "Error: \"" << fileName << "\" is not a circuit checkpoint!!" << endl;
+        return false;
+    }
+    memcpy(&header, file.begin(), sizeof(header));
+    if (header.version != CIR_CKPT_VERSION || header.byteOrder != CIR_CKPT_BYTE_ORDER) {
+        cerr << "Error: checkpoint version " << header.version << " is not supported!!"
+             << endl;
+        return false;
+    }
+
+    CirCkptReader in(file.begin() + sizeof(header), file.end());
+    n = header.nGates;
+    types = in.getArray<uint8_t>(n, 0);
+    lineNo = in.getArray<uint32_t>(n, 0);
+    state = in.getArray<uint64_t>(n, 0);
+    faninBeg = in.getArray<uint64_t>(n + 1, 0);
+    faninLit = in.getArray<uint32_t>(nLit);
+    if (!isOffsets(faninBeg, n, nLit)) {
+        goto corrupted;
+    }
+    symbolBeg = in.getArray<uint64_t>(n + 1, 0);
+    symbols = in.getArray<char>(nChar);
+    if (!in.good() || !isOffsets(symbolBeg, n, nChar) ||
+        n != (uint64_t)header.M + header.O + 1) {
+        goto corrupted;
+    }
+    // CONST 0 is gate 0, the POs are gates M+1..M+O, and each gate has the
+    // fanins of its type
+    for (uint64_t i = 0; i < n; ++i) {
+        if ((types[i] == CKPT_CONST) != (i == 0) || (types[i] == CKPT_PO) != (i > header.M) ||
+            faninBeg[i + 1] - faninBeg[i] != faninSize(types[i])) {
+            goto corrupted;
+        }
+    }
+
+    _M = header.M;
+    _I = header.I;
+    _L = header.L;
+    _O = header.O;
+    _A = header.A;
+
+    // Gates
+    _store.assign(n);
+    for (size_t i = 0; i < n; ++i) {
+        switch (types[i]) {
+            case CKPT_CONST:
+                newGate(CONST_GATE, i, 0);
+                break;
+            case CKPT_PI:
+                newGate(PI_GATE, i, lineNo[i]);
+                break;
+            case CKPT_PO:
+                newGate(PO_GATE, i, lineNo[i]);
+                break;
+            case CKPT_AIG:
+                newGate(AIG_GATE, i, lineNo[i]);
+                break;
+            case CKPT_UNDEF:
+                newGate(UNDEF_GATE, i, 0);
+                break;
+            case CKPT_NONE:
+                continue;
+            default:
+                goto corrupted;
+        }
+        _store.state[i] = state[i];
+        if (symbolBeg[i] != symbolBeg[i + 1]) {
+            _store.symbol.insert(i, string(symbols + symbolBeg[i], symbols + symbolBeg[i + 1]));
+        }
+    }
+
+    // Connection
+    for (size_t i = 0; i < n; ++i) {
+        if (!_store.has(i)) {
+            continue;
+        }
+        for (uint64_t j = faninBeg[i]; j < faninBeg[i + 1]; ++j) {
+            if (faninLit[j] / 2 >= n || !_store.has(faninLit[j] / 2)) {
+                goto corrupted;
+            }
+            _store.addFanin(i, faninLit[j]);
+        }
+    }
+
+    // Gate lists, each of gates of its types
+    {
+        vector<unsigned int> *lists[5] = {&_pin, &_pout, &_aig, &_floating, &_notused};
+        const unsigned int allowed[5] = {1 << CKPT_PI, 1 << CKPT_PO, 1 << CKPT_AIG,
+                                         (1 << CKPT_AIG) | (1 << CKPT_PO),
+                                         (1 << CKPT_AIG) | (1 << CKPT_PI)};
+
+        for (size_t k = 0; k < 5; ++k) {
+            list = in.getArray<uint32_t>(nLit);
+            if (!in.good()) {
+                goto corrupted;
+            }
+            for (uint64_t j = 0; j < nLit; ++j) {
+                if (list[j] >= n || !(allowed[k] & (1 << types[list[j]]))) {
+                    goto corrupted;
+                }
+            }
+            lists[k]->assign(list, list + nLit);
+        }
+    }
+    if (_pin.size() != _I || _pout.size() != _O || _aig.size() != _A) {
+        goto corrupted;
+    }
+    for (size_t k = 0; k < _O; ++k) {
+        if (_pout[k] != _M + 1 + k) {
+            goto corrupted;
+        }
+    }
+
+    // IDs before renumbering
+    list = in.getArray<uint32_t>(nLit);
+    if (!in.good() || (nLit && nLit != n)) {
+        goto corrupted;
+    }
+    _store.origId.assign(list, list + nLit);
+
+    // FEC groups
+    fecBeg = in.getArray<uint64_t>(nGroup);
+    fecLit = in.getArray<uint32_t>(nLit);
+    if (!in.good() || !nGroup || !isOffsets(fecBeg, nGroup - 1, nLit)) {
+        goto corrupted;
+    }
+    FECs.assign(nGroup - 1, vector<unsigned int>());
+    for (size_t i = 0; i + 1 < nGroup; ++i) {
+        for (uint64_t j = fecBeg[i]; j < fecBeg[i + 1]; ++j) {
+            if (fecLit[j] / 2 >= n || !_store.has(fecLit[j] / 2)) {
+                goto corrupted;
+            }
+            FECs[i].push_back(fecLit[j]);
+        }
+    }
+
+    // Comment
+    comment = in.getArray<char>(nChar);
+    if (!in.good()) {
+        goto corrupted;
+    }
+    _comment.str(string(comment, nChar));
+
+    cmdState = header.cmdState;
+
+    return true;
+
+corrupted:
+    cerr << "Error: checkpoint \"" << fileName << "\" is corrupted!!" << endl;
+    reset();
+    return false;
+}
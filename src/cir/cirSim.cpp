@@ -9,32 +9,236 @@
 #include "cirMgr.h"
 
 #include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <new>
 #include <unordered_map>
 
+#if defined(__GNUC__) && defined(__x86_64__)
+#define CIR_SIM_X86
+#include <immintrin.h>
+#endif
+
 #include "cirGate.h"
 #include "util.h"
 
 using namespace std;
 
-using FECGroup = vector<CirGate *>;
+using FECGroup = vector<unsigned int>;
 using FECGroups = vector<FECGroup>;
-using FECHashNode = pair<size_t, FECGroup>;
-using FECHash = unordered_map<size_t, FECGroup>;
+using FECHash = unordered_map<size_t, size_t>;
 
 /*******************************/
 /*   Global variable and enum  */
 /*******************************/
 
+/*
+   Binary pattern format (native byte order):
+
+      CirPtnHeader
+      block[(nPattern + 63) / 64], each of
+         uint64_t pi[nPI]
+         uint64_t po[nPO]
+
+   Pattern 64 * b + j is bit (63 - j) of the words of block b, so the first
+   pattern is the most significant bit as in the text log. A pattern file to
+   simulate may have nPO = 0; a simulation log has the circuit's outputs.
+
+   Bump CIR_PTN_VERSION whenever the layout changes.
+*/
+static const char CIR_PTN_MAGIC[8] = {'C', 'I', 'R', 'P', 'T', 'N', '\0', '\0'};
+static const uint32_t CIR_PTN_VERSION = 1;
+static const uint32_t CIR_PTN_BYTE_ORDER = 0x01020304;
+
+struct CirPtnHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t nPI, nPO;
+    uint64_t nPattern;
+};
+
 /**************************************/
 /*   Static varaibles and functions   */
 /**************************************/
 
+/*
+   Pack a pattern of n '0'/'1' characters into row[], bit i of the row is the
+   i-th character. 8 characters are checked and packed at once: after
+   subtracting '0' from every byte, each byte must be 0 or 1, and the multiply
+   gathers the 8 low bits (little-endian load) into the top byte.
+
+   @return bool
+      False if the pattern contains a non-0/1 character.
+*/
+static bool packPattern(const char *s, size_t n, size_t *row)
+{
+    const uint64_t ones = 0x0101010101010101ULL;
+    uint64_t x, bits = 0;
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        memcpy(&x, s + i, 8);
+        x -= ones * '0';
+        if (x & ~ones) {
+            return false;
+        }
+        bits |= ((x * 0x0102040810204080ULL) >> 56) << (i & 63);
+        if ((i & 63) == 56) {
+            row[i >> 6] = bits;
+            bits = 0;
+        }
+    }
+    for (; i < n; ++i) {
+        if (s[i] != '0' && s[i] != '1') {
+            return false;
+        }
+        bits |= (uint64_t)(s[i] - '0') << (i & 63);
+    }
+    if (n & 63) {
+        row[n >> 6] = bits;
+    }
+
+    return true;
+}
+
+/*
+   Transpose the 64x64 bit matrix in place: bit j of a[i] becomes bit i of
+   a[j]. Blocks of 32x32, 16x16, ..., 1x1 bits are swapped across the
+   diagonal in turn.
+*/
+static void transpose64(size_t *a)
+{
+    size_t m = 0x00000000FFFFFFFFULL, t;
+
+    for (int j = 32; j; j >>= 1, m ^= (m << j)) {
+        for (int k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+            t = ((a[k] >> j) ^ a[k | j]) & m;
+            a[k] ^= t << j;
+            a[k | j] ^= t;
+        }
+    }
+}
+
+/*
+   Word-parallel AND of n words: dst[k] = (a[k] ^ ma) & (b[k] ^ mb), where
+   the mask of an inverted fanin is ~0 and 0 otherwise. A PO is the AND of
+   its fanin with itself.
+*/
+static inline void simAnd(size_t *dst, const size_t *a, const size_t *b, size_t ma, size_t mb, size_t n)
+{
+    for (size_t k = 0; k < n; ++k) {
+        dst[k] = (a[k] ^ ma) & (b[k] ^ mb);
+    }
+}
+
+#ifdef CIR_SIM_X86
+__attribute__((target("avx2"))) static inline void simAndAvx2(size_t *dst, const size_t *a,
+                                                              const size_t *b, size_t ma,
+                                                              size_t mb, size_t n)
+{
+    const __m256i va = _mm256_set1_epi64x(ma), vb = _mm256_set1_epi64x(mb);
+    size_t k = 0;
+
+    for (; k + 4 <= n; k += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(a + k));
+        __m256i y = _mm256_loadu_si256((const __m256i *)(b + k));
+        _mm256_storeu_si256((__m256i *)(dst + k),
+                            _mm256_and_si256(_mm256_xor_si256(x, va), _mm256_xor_si256(y, vb)));
+    }
+    for (; k < n; ++k) {
+        dst[k] = (a[k] ^ ma) & (b[k] ^ mb);
+    }
+}
+
+__attribute__((target("avx512f"))) static inline void simAndAvx512(size_t *dst, const size_t *a,
+                                                                   const size_t *b, size_t ma,
+                                                                   size_t mb, size_t n)
+{
+    const __m512i va = _mm512_set1_epi64(ma), vb = _mm512_set1_epi64(mb);
+    size_t k = 0;
+
+    for (; k + 8 <= n; k += 8) {
+        __m512i x = _mm512_loadu_si512((const void *)(a + k));
+        __m512i y = _mm512_loadu_si512((const void *)(b + k));
+        _mm512_storeu_si512((void *)(dst + k),
+                            _mm512_and_si512(_mm512_xor_si512(x, va), _mm512_xor_si512(y, vb)));
+    }
+    for (; k < n; ++k) {
+        dst[k] = (a[k] ^ ma) & (b[k] ^ mb);
+    }
+}
+#endif
+
+// XOR mask of a literal, ~0 if it is inverted
+static inline size_t invMask(unsigned int lit)
+{
+    return -(size_t)(lit & 1);
+}
+
+/*
+   Run the program on nWord words of the signals, W words per gate. There is
+   one interpreter loop for each kernel, so that the kernel is inlined.
+*/
+typedef void (*CirSimRun)(const CirSimOp *, size_t, size_t *, size_t, size_t);
+
+static void simRun(const CirSimOp *op, size_t n, size_t *state, size_t W, size_t nWord)
+{
+    for (const CirSimOp *end = op + n; op != end; ++op) {
+        simAnd(state + op->dst * W, state + op->a / 2 * W, state + op->b / 2 * W, invMask(op->a),
+               invMask(op->b), nWord);
+    }
+}
+
+#ifdef CIR_SIM_X86
+__attribute__((target("avx2"))) static void simRunAvx2(const CirSimOp *op, size_t n,
+                                                       size_t *state, size_t W, size_t nWord)
+{
+    for (const CirSimOp *end = op + n; op != end; ++op) {
+        simAndAvx2(state + op->dst * W, state + op->a / 2 * W, state + op->b / 2 * W,
+                   invMask(op->a), invMask(op->b), nWord);
+    }
+}
+
+__attribute__((target("avx512f"))) static void simRunAvx512(const CirSimOp *op, size_t n,
+                                                            size_t *state, size_t W,
+                                                            size_t nWord)
+{
+    for (const CirSimOp *end = op + n; op != end; ++op) {
+        simAndAvx512(state + op->dst * W, state + op->a / 2 * W, state + op->b / 2 * W,
+                     invMask(op->a), invMask(op->b), nWord);
+    }
+}
+#endif
+
+/*
+   @return
+      The interpreter of the widest kernel the CPU supports, the portable
+      loop otherwise.
+*/
+static CirSimRun simRunKernel()
+{
+#ifdef CIR_SIM_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return simRunAvx512;
+    } else if (__builtin_cpu_supports("avx2")) {
+        return simRunAvx2;
+    }
+#endif
+    return simRun;
+}
+
+static const CirSimRun simRunWords = simRunKernel();
+
 /************************************************/
 /*   Public functions about Simulation          */
 /************************************************/
@@ -62,31 +266,34 @@ size_t mask(int length)
 
 void CirMgr::randomSim()
 {
-    vector<size_t> txPattern(_I, 0);
-    unsigned int count = 0;
+    vector<size_t> txPattern(_simWords * _I, 0);
+    unsigned int count = 0, n;
     unsigned int prevFECs;
     bool criteria = true;
 
     // Init FECGroups with CirGate
     initFECGroups();
+    initSimState();
 
     while (criteria) {
         // Record #FEC
         prevFECs = FECs.size();
 
         // Simulate with rnGen
-        count += genPattern(txPattern);
-        simulateOnce(txPattern, 64, (count != 64));
+        n = genPattern(txPattern);
+        simulateOnce(txPattern, n, (count != 0));
+        count += n;
 
         cout << "\rTotal #FEC Group = " << FECs.size();
         fflush(NULL);
 
         criteria = (prevFECs != FECs.size()) && (FECs.size());
     }
+    finishSimState();
 
     // Sort FEC Group
-    sort(FECs.begin(), FECs.end(), [](vector<CirGate *> a, vector<CirGate *> b) {
-        return gate(a[0])->_gateId < gate(b[0])->_gateId;
+    sort(FECs.begin(), FECs.end(), [](const FECGroup &a, const FECGroup &b) {
+        return a[0] / 2 < b[0] / 2;
     });
 
     // Final Result
@@ -96,27 +303,65 @@ void CirMgr::randomSim()
 
 void CirMgr::fileSim(ifstream &patternFile)
 {
-    vector<vector<size_t> > txPatterns;
-    unsigned int count = 0;
+    CirPatternBuf buf(patternFile);
+    vector<size_t> txPatterns(_simWords * _I, 0), word(_I, 0);
+    vector<vector<unsigned int> > oldFECs;
+    vector<size_t> oldState;
+    const char *magic = buf.peek(sizeof(CIR_PTN_MAGIC));
+    bool binary = magic && !memcmp(magic, CIR_PTN_MAGIC, sizeof(CIR_PTN_MAGIC));
+    size_t left = 0, batch;
+    unsigned int count = 0, nPO = 0;
+    int n = 64;
+
+    // A binary pattern file is recognized by its magic number
+    if (binary && !parsePatternHeader(buf, left, nPO)) {
+        n = 0;
+    }
 
-    // Parse the Pattern File
-    count = parsePattern(txPatterns, patternFile);
+    // Parse and simulate the file _simWords words at a time, until a short word
+    while (n == 64) {
+        batch = 0;
+        for (size_t w = 0; w < _simWords && n == 64; ++w) {
+            n = (binary) ? parsePatternBlock(word, buf, left, nPO)
+                         : parsePattern(word, buf, (count != 0));
+            if (n > 0) {
+                copy(word.begin(), word.end(), txPatterns.begin() + w * _I);
+                batch += n;
+            }
+        }
+        if (!batch || n < 0) {
+            break;
+        }
 
-    if (count) {
-        initFECGroups();
+        if (!count) {
+            // Kept until the end of the file, which may still be rejected
+            oldFECs = FECs;
+            oldState = _store.state;
+            initFECGroups();
+            initSimState();
+        }
+        simulateOnce(txPatterns, batch, (count != 0));
+        count += batch;
 
-        // Simulate with File
-        for (size_t i = 0; i < txPatterns.size(); ++i) {
-            simulateOnce(txPatterns[i], ((count - i * 64) > 64) ? 64 : count - i * 64, (i != 0));
+        cout << "\rTotal #FEC Group = " << FECs.size();
+        fflush(NULL);
+    }
+    if (count) {
+        finishSimState();
+    }
 
-            cout << "\rTotal #FEC Group = " << FECs.size();
-            fflush(NULL);
+    // A non-0/1 character rejects the whole file: undo the batches before it
+    if (n < 0) {
+        if (count) {
+            FECs.swap(oldFECs);
+            _store.state.swap(oldState);
         }
+        count = 0;
     }
 
     // Sort FEC Group
-    sort(FECs.begin(), FECs.end(), [](vector<CirGate *> a, vector<CirGate *> b) {
-        return gate(a[0])->_gateId < gate(b[0])->_gateId;
+    sort(FECs.begin(), FECs.end(), [](const FECGroup &a, const FECGroup &b) {
+        return a[0] / 2 < b[0] / 2;
     });
 
     // Final Result
@@ -124,6 +369,303 @@ void CirMgr::fileSim(ifstream &patternFile)
     return;
 }
 
+/**************************************/
+/*   class CirPatternBuf member functions */
+/**************************************/
+
+bool CirPatternBuf::getLine(const char *&b, const char *&e)
+{
+    const char *nl;
+    size_t scan = _beg;  // No newline in [_beg, scan)
+
+    while (!(nl = (const char *)memchr(_buf.data() + scan, '\n', _end - scan))) {
+        scan = _end - _beg;
+        if (!fill()) {
+            if (_beg == _end) {
+                return false;
+            }
+            // The last line has no newline
+            nl = _buf.data() + _end;
+            break;
+        }
+    }
+
+    b = _buf.data() + _beg;
+    e = nl;
+    _beg = std::min((size_t)(nl - _buf.data()) + 1, _end);
+
+    return true;
+}
+
+const char *CirPatternBuf::peek(size_t n)
+{
+    while (_end - _beg < n && fill()) {
+    }
+
+    return (_end - _beg < n) ? 0 : _buf.data() + _beg;
+}
+
+const char *CirPatternBuf::get(size_t n)
+{
+    const char *p = peek(n);
+
+    if (p) {
+        _beg += n;
+    }
+
+    return p;
+}
+
+/*
+   Read the next block of the stream. The unread data is moved to the front,
+   and the buffer grows if it is full.
+
+   @return bool
+      False if the end of the stream is reached.
+*/
+bool CirPatternBuf::fill()
+{
+    size_t n;
+
+    if (_eof) {
+        return false;
+    }
+
+    memmove(_buf.data(), _buf.data() + _beg, _end - _beg);
+    _end -= _beg;
+    _beg = 0;
+    if (_end == _buf.size()) {
+        _buf.resize(_buf.size() * 2);
+    }
+
+    _is.read(_buf.data() + _end, _buf.size() - _end);
+    n = _is.gcount();
+    _end += n;
+    _eof = !_is;
+
+    return n;
+}
+
+void CirMgr::setSimLog(ofstream *logFile, bool binary)
+{
+    // Wait for the writer; the number of patterns of the binary log is known
+    // at the end
+    _simLogger.close();
+    if (_simLog && _simLogBinary) {
+        _simLog->seekp(0);
+        encodePatternHeader(_simLogCount, _simLog);
+        _simLog->seekp(0, ios::end);
+    }
+
+    _simLog = logFile;
+    _simLogBinary = binary;
+    _simLogCount = 0;
+
+    if (_simLog && _simLogBinary) {
+        encodePatternHeader(0, _simLog);
+        _simLogger.open(
+            [this](const vector<size_t> &tx, const vector<size_t> &rx, int n) {
+                encodePatternBlock(tx, rx, n, _simLog);
+            },
+            _I + _O);
+    } else if (_simLog) {
+        _simLogger.open(
+            [this](const vector<size_t> &tx, const vector<size_t> &rx, int n) {
+                encodePattern(tx, rx, n, _simLog);
+            },
+            _I + _O);
+    }
+}
+
+/**************************************/
+/*   class CirSimLog member functions */
+/**************************************/
+
+void CirSimLog::open(const Encoder &encode, size_t slotWords)
+{
+    size_t n = RING_BYTES / (std::max(slotWords, (size_t)1) * sizeof(size_t));
+
+    close();
+
+    _encode = encode;
+    _ring.resize(std::max(std::min(n, RING_MAX), (size_t)4));
+    _head = _tail = 0;
+    _stop = false;
+    _thread = thread(&CirSimLog::run, this);
+}
+
+void CirSimLog::close()
+{
+    if (!_thread.joinable()) {
+        return;
+    }
+
+    {
+        lock_guard<mutex> lock(_mtx);
+        _stop = true;
+    }
+    _notEmpty.notify_one();
+    _thread.join();
+
+    _ring.clear();
+    _encode = Encoder();
+}
+
+/*
+   The slot at _tail is only touched by the simulation until _tail is
+   advanced, so the copy is made outside the lock.
+*/
+void CirSimLog::push(const vector<size_t> &tx, const vector<size_t> &rx, int maskLength)
+{
+    size_t t;
+
+    {
+        unique_lock<mutex> lock(_mtx);
+        _notFull.wait(lock, [this] { return _tail - _head < _ring.size(); });
+        t = _tail;
+    }
+
+    Slot &slot = _ring[t % _ring.size()];
+    slot.tx = tx;
+    slot.rx = rx;
+    slot.maskLength = maskLength;
+
+    {
+        lock_guard<mutex> lock(_mtx);
+        ++_tail;
+    }
+    _notEmpty.notify_one();
+}
+
+void CirSimLog::run()
+{
+    size_t h;
+
+    while (true) {
+        {
+            unique_lock<mutex> lock(_mtx);
+            _notEmpty.wait(lock, [this] { return _head != _tail || _stop; });
+            if (_head == _tail) {
+                return;
+            }
+            h = _head;
+        }
+
+        const Slot &slot = _ring[h % _ring.size()];
+        _encode(slot.tx, slot.rx, slot.maskLength);
+
+        {
+            lock_guard<mutex> lock(_mtx);
+            ++_head;
+        }
+        _notFull.notify_one();
+    }
+}
+
+/****************************************/
+/*   class CirSimState member functions   */
+/****************************************/
+
+void CirSimState::assign(size_t rows, size_t words)
+{
+    void *p;
+
+    clear();
+    _stride = (words + LINE - 1) / LINE * LINE;
+    if (posix_memalign(&p, LINE * sizeof(size_t), std::max(rows * _stride, LINE) * sizeof(size_t))) {
+        throw bad_alloc();
+    }
+    _data = (size_t *)p;
+}
+
+void CirSimState::clear()
+{
+    free(_data);
+    _data = 0;
+    _stride = 0;
+}
+
+/***************************************/
+/*   class CirSimPool member functions   */
+/***************************************/
+
+void CirSimPool::open(size_t n)
+{
+    if (size() == n) {
+        return;
+    }
+    close();
+
+    _stop = false;
+    for (size_t k = 1; k < n; ++k) {
+        _workers.emplace_back(&CirSimPool::work, this, k);
+    }
+}
+
+void CirSimPool::close()
+{
+    {
+        lock_guard<mutex> lock(_mtx);
+        _stop = true;
+    }
+    _start.notify_all();
+
+    for (size_t k = 0; k < _workers.size(); ++k) {
+        _workers[k].join();
+    }
+    _workers.clear();
+    // The next workers start waiting for round 1
+    _round = 0;
+}
+
+void CirSimPool::run(const Task &f)
+{
+    if (_workers.empty()) {
+        f(0);
+        return;
+    }
+
+    {
+        lock_guard<mutex> lock(_mtx);
+        _task = &f;
+        _busy = _workers.size();
+        ++_round;
+    }
+    _start.notify_all();
+
+    f(0);
+
+    unique_lock<mutex> lock(_mtx);
+    _done.wait(lock, [this] { return !_busy; });
+    _task = 0;
+}
+
+void CirSimPool::work(size_t k)
+{
+    size_t seen = 0;
+    const Task *f;
+
+    while (true) {
+        {
+            unique_lock<mutex> lock(_mtx);
+            _start.wait(lock, [this, seen] { return _round != seen || _stop; });
+            if (_stop) {
+                return;
+            }
+            seen = _round;
+            f = _task;
+        }
+
+        (*f)(k);
+
+        {
+            lock_guard<mutex> lock(_mtx);
+            --_busy;
+        }
+        _done.notify_one();
+    }
+}
+
 /*************************************************/
 /*   Private member functions about Simulation   */
 /*************************************************/
@@ -132,50 +674,220 @@ void CirMgr::fileSim(ifstream &patternFile)
  * @brief Algorithm: All-Gate Simulation
  * @param[in] txPatterns The patterns array for all input
  */
-void CirMgr::simulateOnce(const vector<size_t> &txPatterns, int maskLength, bool again)
+void CirMgr::simulateOnce(const vector<size_t> &txPatterns, size_t count, bool again)
 {
-    vector<size_t> rxPatterns(_O, 0);
+    const size_t nWord = (count + 63) / 64;
+    vector<size_t> rxPatterns(nWord * _O, 0);
 
-    feedSignal(txPatterns);
-    getSignal(rxPatterns);
-    splitFECGroups(maskLength, again);
+    feedSignal(txPatterns, nWord);
+    getSignal(rxPatterns, nWord);
+    splitFECGroups(count, again);
 
+    // Encoded by the writer thread, one word at a time
     if (_simLog) {
-        encodePattern(txPatterns, rxPatterns, maskLength, _simLog);
+        for (size_t w = 0; w < nWord; ++w) {
+            int n = (int)std::min(count - 64 * w, (size_t)64);
+
+            _simLogger.push(vector<size_t>(txPatterns.begin() + w * _I,
+                                           txPatterns.begin() + (w + 1) * _I),
+                            vector<size_t>(rxPatterns.begin() + w * _O,
+                                           rxPatterns.begin() + (w + 1) * _O),
+                            n);
+            _simLogCount += n;
+        }
+    }
+
+    // The gate reports show the last word
+    for (size_t i = 0; i < _store.type.size(); ++i) {
+        _store.state[i] = _simState.row(i)[nWord - 1];
     }
 }
 
+/*
+   A gate which is not simulated keeps its signal from the last simulation
+   in every word.
+*/
+void CirMgr::initSimState()
+{
+    _simState.assign(_store.type.size(), _simWords);
+    for (size_t i = 0; i < _store.type.size(); ++i) {
+        fill_n(_simState.row(i), _simState.stride(), _store.state[i]);
+    }
+    _simPool.open(_simThreads);
+}
+
+void CirMgr::finishSimState()
+{
+    _simState.clear();
+    _simPool.close();
+}
+
 /**
- * @brief Give Input Signal to AIG. Set the value for each CirPIGate.
+ * @brief Give Input Signal to AIG. Set the value for each PI.
  */
-void CirMgr::feedSignal(const vector<size_t> &patterns)
+void CirMgr::feedSignal(const vector<size_t> &patterns, size_t nWord)
 {
     for (size_t i = 0; i < _I; ++i) {
-        _gates[_pin[i]]->setState(patterns[i]);
+        for (size_t w = 0; w < nWord; ++w) {
+            _simState.row(_pin[i])[w] = patterns[w * _I + i];
+        }
     }
 }
 
 /*
-   Get output signal of AIG.
+   Get output signal of AIG. The compiled program simulates each gate on
+   nWord words at once. The native code is built on the first batch after
+   the program changes, and always simulates the whole rows.
+
+   Each thread of the pool runs the whole program on its own block of
+   words, whole cache lines of each row, so that no two threads write the
+   same line of a row. With fewer lines than threads, the interpreter shares
+   the gates of each level instead.
 */
-void CirMgr::getSignal(vector<size_t> &patterns)
+void CirMgr::getSignal(vector<size_t> &patterns, size_t nWord)
 {
-    vector<CirGate *> dfslist;
+    const vector<CirSimOp> &prog = simProgram();
+    const size_t W = _simState.stride();
+    const size_t *state = _simState.data();
+
+    if (_simNativeOn && !_simNative.ready(_simProgStamp, W) &&
+        !_simNative.build(prog, W, _simProgStamp)) {
+        cerr << "Note: native simulation is not available, using the interpreter..." << endl;
+        _simNativeOn = false;
+    }
+
+    const size_t span = (_simNativeOn) ? W : nWord;
+    const size_t nLine = (span + SIM_LINE - 1) / SIM_LINE, nThread = _simPool.size();
+
+    if (!_simNativeOn && nLine < nThread) {
+        simulateLevels(nWord);
+    } else {
+        _simPool.run([&](size_t k) {
+            size_t w0 = std::min(k * nLine / nThread * SIM_LINE, span);
+            size_t w1 = std::min((k + 1) * nLine / nThread * SIM_LINE, span);
 
-    // Build up dfslist
-    CirGate::raiseGlobalMarker();
-    for (size_t o = _M + 1; o < _M + _O + 1; ++o) {
-        DepthFirstTraversal(_gates[o], dfslist);
+            if (w0 == w1) {
+                return;
+            } else if (_simNativeOn) {
+                _simNative.run(_simState.data(), w0, w1);
+            } else {
+                simRunWords(prog.data(), prog.size(), _simState.data() + w0, W, w1 - w0);
+            }
+        });
     }
 
     // For each gate, get the value
+    for (size_t o = 0; o < _O; ++o) {
+        for (size_t w = 0; w < nWord; ++w) {
+            patterns[w * _O + o] = state[_pout[o] * W + w];
+        }
+    }
+}
+
+/*
+   For each gate, get the value: AIG = A & B, PO = A.
+*/
+const vector<CirSimOp> &CirMgr::simProgram()
+{
+    CirSimOp op;
+    unsigned int *in;
+
+    if (_simProgValid) {
+        return _simProg;
+    }
+
+    const vector<unsigned int> &dfslist = dfsList();
+    _simProg.clear();
     for (size_t i = 0; i < dfslist.size(); ++i) {
-        dfslist[i]->operate();
+        op.dst = dfslist[i];
+        in = &_store.fanin[2 * op.dst];
+        if (_store.type[op.dst] == AIG_GATE) {
+            op.a = in[0];
+            op.b = in[1];
+        } else if (_store.type[op.dst] == PO_GATE) {
+            op.a = op.b = in[0];
+        } else {
+            continue;
+        }
+        _simProg.push_back(op);
     }
+    _simProgValid = true;
+    ++_simProgStamp;
 
-    // For each gate, get the value
-    for (size_t o = 0; o < _O; ++o) {
-        patterns[o] = _gates[_pout[o]]->getState();
+    return _simProg;
+}
+
+/*
+   The level of a gate is one more than the highest level of its fanins, the
+   PIs and the constant are level 0. The operations of a level are kept in
+   the order of simProgram().
+*/
+const vector<CirSimOp> &CirMgr::simLevelProgram()
+{
+    const vector<CirSimOp> &prog = simProgram();
+    vector<unsigned int> level(_store.type.size(), 0);
+    vector<size_t> at;
+    unsigned int top = 0;
+
+    if (_simLevelStamp == _simProgStamp) {
+        return _simLevelProg;
+    }
+
+    for (size_t i = 0; i < prog.size(); ++i) {
+        const CirSimOp &op = prog[i];
+        level[op.dst] = std::max(level[op.a / 2], level[op.b / 2]) + 1;
+        top = std::max(top, level[op.dst]);
+    }
+
+    // Counting sort by level
+    _simLevelBeg.assign(top + 2, 0);
+    for (size_t i = 0; i < prog.size(); ++i) {
+        ++_simLevelBeg[level[prog[i].dst] + 1];
+    }
+    for (unsigned int l = 1; l <= top + 1; ++l) {
+        _simLevelBeg[l] += _simLevelBeg[l - 1];
+    }
+
+    at.assign(_simLevelBeg.begin(), _simLevelBeg.end());
+    _simLevelProg.resize(prog.size());
+    for (size_t i = 0; i < prog.size(); ++i) {
+        _simLevelProg[at[level[prog[i].dst]]++] = prog[i];
+    }
+    _simLevelStamp = _simProgStamp;
+
+    return _simLevelProg;
+}
+
+/*
+   Simulate the levels in order, the threads of the pool taking chunks of
+   the operations of a level until it is done. A chunk reads and writes
+   about three rows per operation, and is sized so that they stay in L2. A
+   level of one chunk is run on this thread alone.
+*/
+void CirMgr::simulateLevels(size_t nWord)
+{
+    const vector<CirSimOp> &prog = simLevelProgram();
+    const size_t W = _simState.stride();
+    const size_t row = (nWord + SIM_LINE - 1) / SIM_LINE * SIM_LINE * sizeof(size_t);
+    const size_t chunk = std::max(SIM_L2 / (3 * row), (size_t)1);
+    size_t *state = _simState.data();
+
+    for (size_t l = 0; l + 1 < _simLevelBeg.size(); ++l) {
+        const size_t beg = _simLevelBeg[l], end = _simLevelBeg[l + 1];
+        atomic<size_t> next(beg);
+
+        if (end - beg <= chunk) {
+            simRunWords(prog.data() + beg, end - beg, state, W, nWord);
+            continue;
+        }
+
+        _simPool.run([&](size_t) {
+            size_t b;
+
+            while ((b = next.fetch_add(chunk)) < end) {
+                simRunWords(prog.data() + b, std::min(chunk, end - b), state, W, nWord);
+            }
+        });
     }
 }
 
@@ -184,92 +896,132 @@ void CirMgr::getSignal(vector<size_t> &patterns)
    1. Just initialize the FEC Groups
    2. Running over some patterns
 */
-void CirMgr::splitFECGroups(int maskLength, bool again)
+void CirMgr::splitFECGroups(size_t count, bool again)
 {
     // TODO: Fixed Complement Output Problem
+    const size_t nWord = (count + 63) / 64;
     FECGroups newFECs;
     FECHash hashTable;
     FECHash::iterator hashIt;
-    size_t value;
-    size_t m = mask(maskLength);
+    vector<size_t> m(nWord), key, next;  // Keys of the new groups, nWord words each
+    size_t h, g, k, *value;
     bool setInvert;
 
+    for (size_t w = 0; w < nWord; ++w) {
+        m[w] = mask((int)std::min(count - 64 * w, (size_t)64));
+    }
+
     for (size_t i = 0; i < FECs.size(); ++i) {
         // Init: Clean the hashTable for each FEC Group
         hashTable.clear();
+        key.clear();
+        next.clear();
+        g = newFECs.size();
 
         // hashTable only maintain 1 new FEC Group for 1 simulation value
         for (FECGroup::iterator it = FECs[i].begin(); it != FECs[i].end(); ++it) {
             // Handling Complement Bits Problems
-            value = gate(*it)->getState();
+            value = _simState.row(*it / 2);
 
             // If keep running the Simulations...
             if (again) {
                 setInvert = isInv(*it);
-            } else if (value > (m >> 1)) {  // If it's first time to run FEC Simulations...
+            } else if (value[0] > (m[0] >> 1)) {  // If it's first time to run FEC Simulations...
                 setInvert = true;
             } else {
                 setInvert = false;
             }
 
-            if (setInvert) {
-                value = invert(value) & m;
+            // Key of the gate in the phase of the group
+            key.resize(key.size() + nWord);
+            h = 0;
+            for (size_t w = 0; w < nWord; ++w) {
+                key[key.size() - nWord + w] = (setInvert) ? invert(value[w]) & m[w] : value[w];
+                h = (h ^ key[key.size() - nWord + w]) * 0x9E3779B97F4A7C15ULL;
             }
 
-            // Hashing
-            hashIt = hashTable.find(value);
+            // Hashing; the new groups of the same hash are chained by next
+            k = NO_LIT;
+            if ((hashIt = hashTable.find(h)) != hashTable.end()) {
+                for (k = hashIt->second; k != NO_LIT; k = next[k - g]) {
+                    if (equal(key.end() - nWord, key.end(), key.begin() + (k - g) * nWord)) {
+                        break;
+                    }
+                }
+            }
 
             // Find exists group
-            if (hashIt != hashTable.end()) {
-                hashIt->second.push_back((setInvert) ? setInv(*it) : *it);
+            if (k != NO_LIT) {
+                newFECs[k].push_back(*it | setInvert);
+                key.resize(key.size() - nWord);
             } else {  // No exists group here, initialize one
-                hashTable.insert(
-                    FECHashNode(value, vector<CirGate *>(1, (setInvert) ? setInv(*it) : *it)));
+                next.push_back((hashIt != hashTable.end()) ? hashIt->second : NO_LIT);
+                hashTable[h] = newFECs.size();
+                newFECs.push_back(FECGroup(1, *it | setInvert));
             }
         }
 
-        // Add to new FEC Groups when #gates in group > 1
-        for (FECHash::iterator it = hashTable.begin(); it != hashTable.end(); ++it) {
-            if ((it->second).size() > 1) {
-                newFECs.push_back(it->second);
+        // Keep the new FEC Groups when #gates in group > 1
+        k = g;
+        for (size_t j = g; j < newFECs.size(); ++j) {
+            if (newFECs[j].size() > 1) {
+                newFECs[k++].swap(newFECs[j]);
             }
         }
+        newFECs.resize(k);
     }
 
     // Finally replace the FEC Groups information
-    FECs = newFECs;
+    FECs.swap(newFECs);
 }
 
 void CirMgr::initFECGroups()
 {
-    // Init FECGroups with CirGate
+    // Init FECGroups with the literals of the gates
     // if (FECs.empty())
     // {
     FECs.clear();
     FECs.push_back(FECGroup());
-    FECs[0].push_back(_gates[0]);
+    FECs[0].push_back(0);
     for (size_t i = 0; i < _pin.size(); ++i) {
-        if (_gates[_pin[i]]) {
-            FECs[0].push_back(_gates[_pin[i]]);
+        if (_store.has(_pin[i])) {
+            FECs[0].push_back(2 * _pin[i]);
         }
     }
     for (size_t a = 0; a < _aig.size(); ++a) {
-        if (_gates[_aig[a]]) {
-            FECs[0].push_back(_gates[_aig[a]]);
+        if (_store.has(_aig[a])) {
+            FECs[0].push_back(2 * _aig[a]);
         }
     }
     // for (size_t o = 0; o < _pout.size(); ++o)
-    //    { if (_gates[_pout[o]]) { FECs[0].push_back(_gates[_pout[o]]); } }
+    //    { if (_store.has(_pout[o])) { FECs[0].push_back(2 * _pout[o]); } }
     // }
 }
 
-int CirMgr::parsePattern(vector<vector<size_t> > &patterns, istream &is) const
+/*
+   The patterns are packed into 64-bit rows, then transposed into one word per
+   input by blocks of 64x64 bits. The first pattern of the batch is the most
+   significant bit, as encodePattern() expects.
+*/
+int CirMgr::parsePattern(vector<size_t> &patterns, CirPatternBuf &buf, bool again) const
 {
-    vector<size_t> ptn(_I, 0);
+    const size_t nWord = (_I + 63) / 64;
+    vector<size_t> rows(64 * nWord, 0);
+    size_t block[64];
     string ptnStr = "";
-    int count = 0, tmp;
+    const char *b, *e;
+    int count = 0;
 
-    while (getline(is, ptnStr)) {
+    while (count < 64 && buf.getLine(b, e)) {
+        size_t *row = &rows[count * nWord];
+
+        // Most lines are exactly the pattern
+        if ((size_t)(e - b) == _I && packPattern(b, _I, row)) {
+            ++count;
+            continue;
+        }
+
+        ptnStr.assign(b, e);
         ptnStr.erase(remove_if(ptnStr.begin(), ptnStr.end(), ::isspace), ptnStr.end());
 
         // Error Detection
@@ -277,161 +1029,178 @@ int CirMgr::parsePattern(vector<vector<size_t> > &patterns, istream &is) const
             /* ignore this line */
             continue;
         } else if (ptnStr.length() < _I) {
+            if (again) {
+                cout << endl;
+            }
             cout << "Bad Pattern: The length of pattern: " << ptnStr.length()
                  << ", excepted PI: " << _I << endl;
 
-            return count;
+            break;
         } else if (ptnStr.length() > _I) {
             cout << endl
                  << "Error: Pattern(" << ptnStr << ") length(" << ptnStr.length()
                  << ") does not match the number of inputs(" << _I << ") in a circuit!!" << endl;
 
-            return count;
-        }
-
-        // Feed the bits into patterns
-        for (int i = 0; i < _I; ++i) {
-            tmp = (int)ptnStr[i] - 48;
+            break;
+        } else if (!packPattern(ptnStr.data(), _I, row)) {
+            size_t i = ptnStr.find_first_not_of("01");
 
-            // Error Detection
-            if (tmp != 0 && tmp != 1) {
-                cout << endl
-                     << "Error: Pattern(" << ptnStr << ") contains a non-0/1 character('"
-                     << ptnStr[i] << "')." << endl;
-
-                return false;
-            }
+            cout << endl
+                 << "Error: Pattern(" << ptnStr << ") contains a non-0/1 character('"
+                 << ptnStr[i] << "')." << endl;
 
-            ptn[i] = (ptn[i] << 1) + tmp;
+            return -1;
         }
 
         // To count a line was prased successfully.
         ++count;
+    }
 
-        if (count % 64 == 0) {
-            patterns.push_back(ptn);
-            fill(ptn.begin(), ptn.end(), 0);
+    // Pattern j of the batch goes to bit (count - 1 - j)
+    for (size_t w = 0; w < nWord; ++w) {
+        for (int r = 0; r < 64; ++r) {
+            block[r] = (r < count) ? rows[(count - 1 - r) * nWord + w] : 0;
+        }
+        transpose64(block);
+        for (size_t k = 0; k < 64 && w * 64 + k < _I; ++k) {
+            patterns[w * 64 + k] = block[k];
         }
     }
 
-    patterns.push_back(ptn);
     return count;
 }
 
+/*
+   The batch is formatted into one string and written at once.
+*/
 void CirMgr::encodePattern(const vector<size_t> &txPattern, const vector<size_t> &rxPattern,
                            int maskLength, ostream *os) const
 {
-    // size_t parallelMask = mask(maskLength);
+    string out((_I + _O + 2) * maskLength, ' ');
     size_t bitMask = (size_t)1 << (maskLength - 1);
+    char *p = &out[0];
 
     for (int i = 0; i < maskLength; ++i) {
-        for (int j = 0; j < _I; ++j) {
-            *(os) << ((bool)(txPattern[j] & bitMask));
+        for (size_t j = 0; j < _I; ++j) {
+            *p++ = (txPattern[j] & bitMask) ? '1' : '0';
         }
-        *(os) << ' ';
+        ++p;
 
-        for (int j = 0; j < _O; ++j) {
-            *(os) << ((bool)(rxPattern[j] & bitMask));
+        for (size_t j = 0; j < _O; ++j) {
+            *p++ = (rxPattern[j] & bitMask) ? '1' : '0';
         }
-        *(os) << endl;
+        *p++ = '\n';
 
         bitMask = bitMask >> 1;
     }
-}
 
-/**
- * @brief Generate bits Pattern with length size_t
- * @param[in] pattern vector to store the patterns, should preconfig the length of patterns
- */
-int CirMgr::genPattern(vector<size_t> &patterns) const
-{
-    const vector<size_t>::iterator end = patterns.end();
-
-    for (vector<size_t>::iterator it = patterns.begin(); it != end; ++it) {
-        *it = ((size_t)rnGen(INT_MAX) << 32) + rnGen(INT_MAX);
-    }
-
-    return 64;
+    os->write(out.data(), out.size());
 }
 
-/*************************************************/
-/*   Private member functions about CirGate      */
-/*************************************************/
-
-const size_t &CirGate::getState()
+void CirMgr::encodePatternHeader(size_t count, ostream *os) const
 {
-    return _state;
-}
+    CirPtnHeader h;
 
-void CirGate::setState(const size_t &s)
-{
-    _state = s;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CIR_PTN_MAGIC, sizeof(h.magic));
+    h.version = CIR_PTN_VERSION;
+    h.byteOrder = CIR_PTN_BYTE_ORDER;
+    h.nPI = _I;
+    h.nPO = _O;
+    h.nPattern = count;
+
+    os->write((const char *)&h, sizeof(h));
 }
 
-void CirGate::operate()
+/*
+   The maskLength patterns are in the low bits of the words, and are moved to
+   the high bits of the block.
+*/
+void CirMgr::encodePatternBlock(const vector<size_t> &txPattern, const vector<size_t> &rxPattern,
+                                int maskLength, ostream *os) const
 {
-    /* Do Nothing */
-}
+    vector<uint64_t> block(_I + _O);
+    const int shift = 64 - maskLength;
 
-/*************************************************/
-/*  Private member functions about CirConstGate  */
-/*************************************************/
+    for (size_t i = 0; i < _I; ++i) {
+        block[i] = (uint64_t)txPattern[i] << shift;
+    }
+    for (size_t o = 0; o < _O; ++o) {
+        block[_I + o] = (uint64_t)rxPattern[o] << shift;
+    }
 
-void CirConstGate::operate()
-{
-    /* Do Nothing */
+    os->write((const char *)block.data(), block.size() * sizeof(uint64_t));
 }
 
-const size_t &CirConstGate::getState()
+bool CirMgr::parsePatternHeader(CirPatternBuf &buf, size_t &count, unsigned int &nPO) const
 {
-    return 0;
-}
+    const char *p = buf.get(sizeof(CirPtnHeader));
+    CirPtnHeader h;
 
-/*************************************************/
-/*  Private member functions about CirUndefGate  */
-/*************************************************/
+    if (!p) {
+        cout << endl << "Error: Pattern file is corrupted!!" << endl;
+        return false;
+    }
+    memcpy(&h, p, sizeof(h));
+
+    if (h.byteOrder != CIR_PTN_BYTE_ORDER) {
+        cout << endl << "Error: Pattern file is corrupted!!" << endl;
+        return false;
+    } else if (h.version != CIR_PTN_VERSION) {
+        cout << endl
+             << "Error: Pattern file version " << h.version << " is not supported!!" << endl;
+        return false;
+    } else if (h.nPI != _I) {
+        cout << endl
+             << "Error: Pattern file #PI(" << h.nPI << ") does not match the number of inputs("
+             << _I << ") in a circuit!!" << endl;
+        return false;
+    }
 
-/*
-void
-CirUndefGate::operate()
-{
-   // throw "Not vaild for CirUndefGate::operate() (" + to_string(_gateId) +
-")\n";
-}
+    count = h.nPattern;
+    nPO = h.nPO;
 
-const size_t&
-CirUndefGate::getState()
-{
-   // throw "Not vaild for CirUndefGate::getState() (" + to_string(_gateId) +
-")\n"; return 0;
+    return true;
 }
-*/
-
-/*************************************************/
-/*  Private member functions about CirPOGate     */
-/*************************************************/
 
 /*
-   For CirPOGate, State = Fanin.State
+   The block is moved to the low bits of the words, as parsePattern() does.
 */
-void CirPOGate::operate()
+int CirMgr::parsePatternBlock(vector<size_t> &patterns, CirPatternBuf &buf, size_t &left,
+                              unsigned int nPO) const
 {
-    _state = isInv(_fanin[0]) ? invert(gate(_fanin[0])->getState()) : gate(_fanin[0])->getState();
-}
+    const int count = std::min(left, (size_t)64);
+    const char *p;
+    uint64_t w;
+
+    if (!count) {
+        return 0;
+    } else if (!(p = buf.get((_I + (size_t)nPO) * sizeof(uint64_t)))) {
+        cout << endl << "Error: Pattern file is truncated!!" << endl;
+        left = 0;
+        return 0;
+    }
 
-/*************************************************/
-/*  Private member functions about CirAIGate     */
-/*************************************************/
+    for (size_t i = 0; i < _I; ++i) {
+        memcpy(&w, p + i * sizeof(uint64_t), sizeof(w));
+        patterns[i] = w >> (64 - count);
+    }
+    left -= count;
 
-/*
-   For CirAIGate, State = A & B
-*/
-void CirAIGate::operate()
+    return count;
+}
+
+/**
+ * @brief Generate bits Pattern with length size_t
+ * @param[in] pattern vector to store the patterns, should preconfig the length of patterns
+ */
+int CirMgr::genPattern(vector<size_t> &patterns) const
 {
-    size_t in[2];
+    const vector<size_t>::iterator end = patterns.end();
 
-    in[0] = isInv(_fanin[0]) ? invert(gate(_fanin[0])->getState()) : gate(_fanin[0])->getState();
-    in[1] = isInv(_fanin[1]) ? invert(gate(_fanin[1])->getState()) : gate(_fanin[1])->getState();
+    for (vector<size_t>::iterator it = patterns.begin(); it != end; ++it) {
+        *it = ((size_t)rnGen(INT_MAX) << 32) + rnGen(INT_MAX);
+    }
 
-    _state = in[0] & in[1];
+    return 64 * _simWords;
 }
@@ -0,0 +1,363 @@
+/****************************************************************************
+  FileName     [ cirZip.cpp ]
+  PackageName  [ cir ]
+  Synopsis     [ Define compressed (gzip / xz) netlist streams ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2008-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+
+#include "cirZip.h"
+
+#include <lzma.h>
+#include <sys/mman.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+/**************************************/
+/*   Static varaibles and functions   */
+/**************************************/
+
+static bool hasSuffix(const string &s, const char *suffix)
+{
+    size_t n = strlen(suffix);
+
+    return s.size() > n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+CirZipType cirZipType(const string &fileName)
+{
+    if (hasSuffix(fileName, ".gz")) {
+        return CIR_ZIP_GZ;
+    } else if (hasSuffix(fileName, ".xz")) {
+        return CIR_ZIP_XZ;
+    }
+
+    return CIR_ZIP_NONE;
+}
+
+CirZipType cirZipType(const char *data, size_t n)
+{
+    static const char xzMagic[6] = {'\xfd', '7', 'z', 'X', 'Z', '\0'};
+
+    if (n >= 2 && data[0] == '\x1f' && data[1] == '\x8b') {
+        return CIR_ZIP_GZ;
+    } else if (n >= sizeof(xzMagic) && memcmp(data, xzMagic, sizeof(xzMagic)) == 0) {
+        return CIR_ZIP_XZ;
+    }
+
+    return CIR_ZIP_NONE;
+}
+
+/**************************************/
+/*   class CirUnzip member functions  */
+/**************************************/
+
+CirUnzip::~CirUnzip()
+{
+    close();
+}
+
+/*
+   The output range is reserved without backing memory (MAP_NORESERVE), pages
+   are only committed as the decompressor writes to them.
+*/
+bool CirUnzip::open(const char *src, size_t n, CirZipType type)
+{
+    static const size_t caps[] = {(size_t)1 << 40, (size_t)1 << 36, (size_t)1 << 32,
+                                  (size_t)1 << 30};
+    void *p = MAP_FAILED;
+
+    close();
+
+    for (size_t i = 0; i < sizeof(caps) / sizeof(caps[0]) && p == MAP_FAILED; ++i) {
+        _cap = caps[i];
+        p = mmap(NULL, _cap, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                 -1, 0);
+    }
+    if (p == MAP_FAILED) {
+        _cap = 0;
+        return false;
+    }
+
+    _buf = (char *)p;
+    _size = 0;
+    _done = false;
+    _good = true;
+    _stop = false;
+    _thread = thread(&CirUnzip::run, this, src, n, type);
+
+    return true;
+}
+
+void CirUnzip::close()
+{
+    {
+        lock_guard<mutex> lock(_mtx);
+        _stop = true;
+    }
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+
+    if (_buf) {
+        munmap(_buf, _cap);
+    }
+    _buf = 0;
+    _cap = _size = 0;
+    _done = true;
+}
+
+bool CirUnzip::wait(size_t &n)
+{
+    unique_lock<mutex> lock(_mtx);
+
+    _cv.wait(lock, [this, n] { return _size > n || _done; });
+    if (_size > n) {
+        n = _size;
+        return true;
+    }
+
+    return false;
+}
+
+bool CirUnzip::good()
+{
+    lock_guard<mutex> lock(_mtx);
+
+    return _good;
+}
+
+/*
+   Make the first n bytes visible to the reader.
+
+   @return bool
+      False if the reader has closed the stream.
+*/
+bool CirUnzip::publish(size_t n)
+{
+    {
+        lock_guard<mutex> lock(_mtx);
+        _size = n;
+        if (_stop) {
+            return false;
+        }
+    }
+    _cv.notify_all();
+
+    return true;
+}
+
+/*
+   Decompressor thread. Concatenated gzip members / xz streams are decoded
+   as one file.
+*/
+void CirUnzip::run(const char *src, size_t n, CirZipType type)
+{
+    size_t size = 0, room;
+    bool ok = false;
+
+    if (type == CIR_ZIP_GZ) {
+        z_stream zs;
+        size_t left = n;
+        int ret = Z_OK;
+
+        memset(&zs, 0, sizeof(zs));
+        if (inflateInit2(&zs, 15 + 32) == Z_OK) {
+            zs.next_in = (Bytef *)src;
+            while (size < _cap) {
+                // avail_in is 32 bits wide
+                if (!zs.avail_in && left) {
+                    zs.avail_in = (uInt)min(left, (size_t)1 << 30);
+                    left -= zs.avail_in;
+                }
+
+                room = min(CHUNK, _cap - size);
+                zs.next_out = (Bytef *)_buf + size;
+                zs.avail_out = (uInt)room;
+                ret = inflate(&zs, Z_NO_FLUSH);
+                size += room - zs.avail_out;
+                if (!publish(size)) {
+                    break;
+                }
+
+                if (ret == Z_STREAM_END) {
+                    if (!zs.avail_in && !left) {
+                        ok = true;
+                        break;
+                    }
+                    inflateReset(&zs);
+                } else if (ret != Z_OK) {
+                    break;
+                }
+            }
+            inflateEnd(&zs);
+        }
+    } else if (type == CIR_ZIP_XZ) {
+        lzma_stream ls = LZMA_STREAM_INIT;
+        lzma_ret ret;
+
+        if (lzma_stream_decoder(&ls, UINT64_MAX, LZMA_CONCATENATED) == LZMA_OK) {
+            ls.next_in = (const uint8_t *)src;
+            ls.avail_in = n;
+            while (size < _cap) {
+                room = min(CHUNK, _cap - size);
+                ls.next_out = (uint8_t *)_buf + size;
+                ls.avail_out = room;
+                ret = lzma_code(&ls, LZMA_FINISH);
+                size += room - ls.avail_out;
+                if (!publish(size)) {
+                    break;
+                }
+
+                if (ret == LZMA_STREAM_END) {
+                    ok = true;
+                    break;
+                } else if (ret != LZMA_OK) {
+                    break;
+                }
+            }
+            lzma_end(&ls);
+        }
+    }
+
+    {
+        lock_guard<mutex> lock(_mtx);
+        _done = true;
+        _good = ok;
+    }
+    _cv.notify_all();
+}
+
+/**************************************/
+/*   class CirZipBuf member functions */
+/**************************************/
+
+CirZipBuf::CirZipBuf(streambuf *sb, CirZipType type)
+    : _sb(sb), _type(type), _strm(0), _in(new char[CHUNK]), _out(new char[CHUNK]), _good(true),
+      _finished(false)
+{
+    if (_type == CIR_ZIP_GZ) {
+        z_stream *zs = new z_stream;
+
+        memset(zs, 0, sizeof(*zs));
+        _good = deflateInit2(zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                             Z_DEFAULT_STRATEGY) == Z_OK;
+        _strm = zs;
+    } else if (_type == CIR_ZIP_XZ) {
+        lzma_stream init = LZMA_STREAM_INIT;
+        lzma_stream *ls = new lzma_stream(init);
+
+        _good = lzma_easy_encoder(ls, LZMA_PRESET_DEFAULT, LZMA_CHECK_CRC64) == LZMA_OK;
+        _strm = ls;
+    }
+
+    setp(_in, _in + CHUNK);
+}
+
+CirZipBuf::~CirZipBuf()
+{
+    finish();
+
+    if (_type == CIR_ZIP_GZ) {
+        deflateEnd((z_stream *)_strm);
+        delete (z_stream *)_strm;
+    } else if (_type == CIR_ZIP_XZ) {
+        lzma_end((lzma_stream *)_strm);
+        delete (lzma_stream *)_strm;
+    }
+
+    delete[] _in;
+    delete[] _out;
+}
+
+bool CirZipBuf::finish()
+{
+    if (!_finished) {
+        _good = compress(true) && _good;
+        _finished = true;
+        _sb->pubsync();
+    }
+
+    return _good;
+}
+
+int CirZipBuf::overflow(int c)
+{
+    if (_finished || !compress(false)) {
+        return traits_type::eof();
+    }
+
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+
+    return traits_type::not_eof(c);
+}
+
+int CirZipBuf::sync()
+{
+    return (compress(false) && _sb->pubsync() == 0) ? 0 : -1;
+}
+
+/*
+   Compress the put area to the output streambuf.
+
+   @param end
+      End the compressed stream after the put area.
+*/
+bool CirZipBuf::compress(bool end)
+{
+    size_t n = pptr() - pbase(), have;
+    z_stream *zs = (z_stream *)_strm;
+    lzma_stream *ls = (lzma_stream *)_strm;
+    bool more = true;
+
+    setp(_in, _in + CHUNK);
+    if (!_good) {
+        return false;
+    }
+
+    if (_type == CIR_ZIP_NONE) {
+        _good = (size_t)_sb->sputn(_in, n) == n;
+        return _good;
+    } else if (_type == CIR_ZIP_GZ) {
+        zs->next_in = (Bytef *)_in;
+        zs->avail_in = (uInt)n;
+    } else {
+        ls->next_in = (const uint8_t *)_in;
+        ls->avail_in = n;
+    }
+
+    while (more && _good) {
+        if (_type == CIR_ZIP_GZ) {
+            int ret;
+
+            zs->next_out = (Bytef *)_out;
+            zs->avail_out = CHUNK;
+            ret = deflate(zs, end ? Z_FINISH : Z_NO_FLUSH);
+            _good = (ret != Z_STREAM_ERROR);
+            have = CHUNK - zs->avail_out;
+            more = end ? ret != Z_STREAM_END : !zs->avail_out;
+        } else {
+            lzma_ret ret;
+
+            ls->next_out = (uint8_t *)_out;
+            ls->avail_out = CHUNK;
+            ret = lzma_code(ls, end ? LZMA_FINISH : LZMA_RUN);
+            _good = (ret == LZMA_OK || ret == LZMA_STREAM_END);
+            have = CHUNK - ls->avail_out;
+            more = end ? ret != LZMA_STREAM_END : !ls->avail_out;
+        }
+
+        if (have && (size_t)_sb->sputn(_out, have) != have) {
+            _good = false;
+        }
+    }
+
+    return _good;
+}
@@ -0,0 +1,124 @@
+/****************************************************************************
+  FileName     [ cirZip.h ]
+  PackageName  [ cir ]
+  Synopsis     [ Define compressed (gzip / xz) netlist streams ]
+  Author       [ Chung-Yang (Ric) Huang ]
+  Copyright    [ Copyleft(c) 2008-present LaDs(III), GIEE, NTU, Taiwan ]
+****************************************************************************/
+
+#ifndef CIR_ZIP_H
+#define CIR_ZIP_H
+
+#include <condition_variable>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <thread>
+
+enum CirZipType {
+    CIR_ZIP_NONE,
+    CIR_ZIP_GZ,
+    CIR_ZIP_XZ
+};
+
+/**
+ * @brief Compression of the file, by the suffix ".gz" or ".xz" of its name
+ */
+CirZipType cirZipType(const std::string &);
+/**
+ * @brief Compression of the data, by its magic number
+ */
+CirZipType cirZipType(const char *, size_t);
+
+/**
+ * @brief Decompress a gzip / xz image in a background thread
+ * @details The output is written to a reserved address range which never
+ * moves, so the reader can parse the decompressed prefix while the rest is
+ * still being decompressed.
+ */
+class CirUnzip
+{
+public:
+    CirUnzip() : _buf(0), _cap(0), _size(0), _done(true), _good(true), _stop(false) {}
+    ~CirUnzip();
+
+    /**
+     * @brief Start decompressing [src, src + n)
+     * @note The source must stay valid until close().
+     */
+    bool open(const char *, size_t, CirZipType);
+    void close();
+
+    const char *data() const
+    {
+        return _buf;
+    }
+    /**
+     * @brief Wait until more than n bytes are decompressed
+     * @param[in,out] n Number of bytes available
+     * @return false if the end of the data is reached
+     */
+    bool wait(size_t &);
+    /**
+     * @brief False if the data is corrupted or too large
+     */
+    bool good();
+
+private:
+    static const size_t CHUNK = 1 << 20;
+
+    CirUnzip(const CirUnzip &);
+    CirUnzip &operator=(const CirUnzip &);
+
+    void run(const char *, size_t, CirZipType);
+    bool publish(size_t);
+
+    char *_buf;
+    size_t _cap;
+    size_t _size;  // Decompressed bytes, guarded by _mtx
+    bool _done;
+    bool _good;
+    bool _stop;
+
+    std::mutex _mtx;
+    std::condition_variable _cv;
+    std::thread _thread;
+};
+
+/**
+ * @brief Output streambuf which compresses to another streambuf
+ */
+class CirZipBuf : public std::streambuf
+{
+public:
+    CirZipBuf(std::streambuf *, CirZipType);
+    ~CirZipBuf();
+
+    /**
+     * @brief Compress the pending data and end the stream
+     * @return false if the compressor or the output fails
+     */
+    bool finish();
+
+protected:
+    int overflow(int);
+    int sync();
+
+private:
+    static const size_t CHUNK = 1 << 18;
+
+    CirZipBuf(const CirZipBuf &);
+    CirZipBuf &operator=(const CirZipBuf &);
+
+    bool compress(bool);
+
+    std::streambuf *_sb;
+    CirZipType _type;
+    void *_strm;  // z_stream or lzma_stream
+    char *_in;
+    char *_out;
+    bool _good;
+    bool _finished;
+};
+
+#endif  // CIR_ZIP_H
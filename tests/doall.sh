@@ -125,3 +125,85 @@ echo do28
 ./fraig -F ./tests.script/do28 &> ./output/do28
 diff ./output/do28 ./output/do28-ref
 
+
+# Outputs of the commands the reference binary does not have are kept in
+# ./tests.script/ref
+
+echo do30
+./fraig -F ./tests.script/do30 &> ./output/do30
+diff ./output/do30 ./tests.script/ref/do30-ref
+
+echo do31
+./fraig -F ./tests.script/do31 &> ./output/do31
+diff ./output/do31 ./tests.script/ref/do31-ref
+
+echo do32
+./fraig -F ./tests.script/do32 &> ./output/do32
+diff ./output/do32 ./tests.script/ref/do32-ref
+
+echo do33
+./fraig -F ./tests.script/do33 &> ./output/do33
+diff ./output/do33 ./tests.script/ref/do33-ref
+
+echo do34
+./fraig -F ./tests.script/do34 &> ./output/do34
+diff ./output/do34 ./tests.script/ref/do34-ref
+
+echo do35
+./fraig -F ./tests.script/do35 &> ./output/do35
+diff ./output/do35 ./tests.script/ref/do35-ref
+
+echo do36
+./fraig -F ./tests.script/do36 &> ./output/do36
+diff ./output/do36 ./tests.script/ref/do36-ref
+
+echo do37
+./fraig -F ./tests.script/do37 &> ./output/do37
+diff ./output/do37 ./tests.script/ref/do37-ref
+diff ./output/do37.log ./tests.script/ref/do37.log-ref
+diff ./output/do37b.log ./tests.script/ref/do37b.log-ref
+diff ./output/do37.ptn ./tests.script/ref/do37.ptn-ref
+
+echo do38
+./fraig -F ./tests.script/do38 &> ./output/do38
+diff ./output/do38 ./tests.script/ref/do38-ref
+
+echo do39
+./fraig -F ./tests.script/do39 &> ./output/do39
+diff ./output/do39 ./tests.script/ref/do39-ref
+
+echo do40
+./fraig -F ./tests.script/do40 &> ./output/do40
+diff ./output/do40 ./tests.script/ref/do40-ref
+
+echo do41
+./fraig -F ./tests.script/do41 &> ./output/do41
+diff ./output/do41 ./tests.script/ref/do41-ref
+
+echo do42
+./fraig -F ./tests.script/do42 &> ./output/do42
+diff ./output/do42 ./tests.script/ref/do42-ref
+
+echo do43
+./fraig -F ./tests.script/do43 &> ./output/do43
+diff ./output/do43 ./tests.script/ref/do43-ref
+
+echo do44
+./fraig -F ./tests.script/do44 &> ./output/do44
+diff ./output/do44 ./tests.script/ref/do44-ref
+
+echo do45
+./fraig -F ./tests.script/do45 &> ./output/do45
+diff ./output/do45 ./tests.script/ref/do45-ref
+
+echo do46
+./fraig -F ./tests.script/do46 &> ./output/do46
+diff ./output/do46 ./tests.script/ref/do46-ref
+
+echo do47
+./fraig -F ./tests.script/do47 &> ./output/do47
+diff ./output/do47 ./tests.script/ref/do47-ref
+
+echo do48
+./fraig -F ./tests.script/do48 &> ./output/do48
+diff ./output/do48 ./tests.script/ref/do48-ref